@@ -0,0 +1,406 @@
+// Hot path benchmarks. Besides the time per call every case reports
+//
+//   allocs/call  heap allocations made by the calling thread
+//   p50/p99/p999 latency of single calls in ns, sampled every 16th call
+//
+// timber-c output is sent to /dev/null so the numbers don't depend on the
+// terminal; the report still goes to the original stdout.
+
+#include <tmb/sinks/buffered_sink.hpp>
+#include <tmb/span.hpp>
+#include <tmb/tmb.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// allocation counting, per thread so contended cases only see their own
+namespace {
+thread_local std::size_t allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+class NullSink : public tmb::Sink {
+  public:
+    void write(const tmb::Record& rec) override {
+        benchmark::DoNotOptimize(rec.message().data());
+    }
+};
+
+class RenderSink : public tmb::Sink {
+  public:
+    explicit RenderSink(bool colors) : _colors(colors) {}
+
+    void write(const tmb::Record& rec) override {
+        _line.clear();
+        tmb::internal::render_default(rec, _line, _colors);
+        benchmark::DoNotOptimize(_line.data());
+        bytes += _line.size();
+    }
+
+    std::size_t bytes = 0;
+
+  private:
+    bool _colors;
+    std::string _line;
+};
+
+constexpr tmb::c::tmb_logger_cfg_t bench_cfg {
+    .log_level     = tmb::c::TMB_LOG_LEVEL_INFO,
+    .enable_colors = false,
+};
+
+std::unique_ptr<tmb::Logger> null_logger() {
+    auto lgr = std::make_unique<tmb::Logger>("bench", bench_cfg);
+    lgr->add_sink(std::make_shared<NullSink>());
+    return lgr;
+}
+
+std::unique_ptr<tmb::Logger> async_null_logger(bool per_thread = false) {
+    auto opts = tmb::AsyncOptions {
+        .capacity      = per_thread ? 1024u : 1u << 16,
+        .per_thread    = per_thread,
+        .lane_capacity = 4096,
+    };
+    auto lgr = std::make_unique<tmb::Logger>("bench", bench_cfg, opts);
+    lgr->add_sink(std::make_shared<NullSink>());
+    return lgr;
+}
+
+constexpr std::uint64_t sample_mask = 15;
+
+// Runs call() once per iteration and reports the per call counters
+template <typename Call>
+void run(benchmark::State& state, Call&& call) {
+    using clock = std::chrono::steady_clock;
+    std::vector<std::int64_t> samples;
+    samples.reserve(1 << 16);
+
+    auto allocs_before = allocations;
+    std::uint64_t n    = 0;
+    for (auto _ : state) {
+        if ((n++ & sample_mask) != 0 || samples.size() == samples.capacity()) {
+            call();
+            continue;
+        }
+        auto t0 = clock::now();
+        call();
+        auto t1 = clock::now();
+        samples.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                        .count());
+    }
+    state.counters["allocs/call"] =
+            benchmark::Counter(static_cast<double>(allocations - allocs_before),
+                               benchmark::Counter::kAvgIterations);
+
+    if (samples.empty()) return;
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&](double p) {
+        auto last = static_cast<double>(samples.size() - 1);
+        auto i    = static_cast<std::size_t>(p * last);
+        return benchmark::Counter(static_cast<double>(samples[i]),
+                                  benchmark::Counter::kAvgThreads);
+    };
+    state.counters["p50"]  = pct(0.50);
+    state.counters["p99"]  = pct(0.99);
+    state.counters["p999"] = pct(0.999);
+}
+
+// --- level filtering ------------------------------------------------------
+
+void BM_DisabledLevel(benchmark::State& state) {
+    auto lgr = null_logger();
+    run(state, [&] { lgr->debug("value {} and {}", 42, 3.14); });
+}
+BENCHMARK(BM_DisabledLevel);
+
+void BM_DisabledLevelDefaultLogger(benchmark::State& state) {
+    tmb::set_level(tmb::LogLevel::Info);
+    run(state, [] { tmb::debug("value {} and {}", 42, 3.14); });
+}
+BENCHMARK(BM_DisabledLevelDefaultLogger);
+
+void BM_DisabledLevelLazy(benchmark::State& state) {
+    auto lgr = null_logger();
+    std::vector<int> book(256, 7);
+    run(state, [&] {
+        lgr->debug("book {}", tmb::lazy([&] {
+            std::string out;
+            for (int v : book) out += std::to_string(v);
+            return out;
+        }));
+    });
+}
+BENCHMARK(BM_DisabledLevelLazy);
+
+void BM_EveryNSuppressed(benchmark::State& state) {
+    auto lgr = null_logger();
+    int i    = 0;
+    run(state, [&] { lgr->info_every_n(1000000000, "value {}", ++i); });
+}
+BENCHMARK(BM_EveryNSuppressed);
+
+void BM_SpanUnderThreshold(benchmark::State& state) {
+    auto lgr = null_logger();
+    run(state, [&] {
+        tmb::Span span(*lgr, "tick", std::chrono::milliseconds(5));
+    });
+}
+BENCHMARK(BM_SpanUnderThreshold);
+
+// --- enabled calls into a null sink, by argument count and type -----------
+
+void BM_NullSinkNoArgs(benchmark::State& state) {
+    auto lgr = null_logger();
+    run(state, [&] { lgr->info("constant message"); });
+}
+BENCHMARK(BM_NullSinkNoArgs);
+
+void BM_NullSinkOneInt(benchmark::State& state) {
+    auto lgr = null_logger();
+    int i    = 0;
+    run(state, [&] { lgr->info("value {}", ++i); });
+}
+BENCHMARK(BM_NullSinkOneInt);
+
+void BM_NullSinkThreeInts(benchmark::State& state) {
+    auto lgr = null_logger();
+    int i    = 0;
+    run(state, [&] {
+        ++i;
+        lgr->info("values {} {} {}", i, i * 2, i * 3);
+    });
+}
+BENCHMARK(BM_NullSinkThreeInts);
+
+void BM_NullSinkSixMixed(benchmark::State& state) {
+    auto lgr = null_logger();
+    int i    = 0;
+    run(state, [&] {
+        lgr->info("{} {} {} {} {} {}", ++i, 2.5, 'c', true, -7L, 99u);
+    });
+}
+BENCHMARK(BM_NullSinkSixMixed);
+
+void BM_NullSinkDouble(benchmark::State& state) {
+    auto lgr = null_logger();
+    double d = 0.0;
+    run(state, [&] { lgr->info("value {:.3f}", d += 0.5); });
+}
+BENCHMARK(BM_NullSinkDouble);
+
+void BM_NullSinkStringView(benchmark::State& state) {
+    auto lgr = null_logger();
+    std::string_view sv = "a string argument of moderate length";
+    run(state, [&] { lgr->info("value {}", sv); });
+}
+BENCHMARK(BM_NullSinkStringView);
+
+void BM_NullSinkLongString(benchmark::State& state) {
+    auto lgr = null_logger();
+    auto str = std::string(static_cast<std::size_t>(state.range(0)), 'x');
+    run(state, [&] { lgr->info("value {}", str); });
+}
+BENCHMARK(BM_NullSinkLongString)->Arg(64)->Arg(1024)->Arg(4096);
+
+void BM_NullSinkFields(benchmark::State& state) {
+    auto lgr = null_logger();
+    if (state.range(0)) lgr->set_field_style(tmb::FieldStyle::Json);
+    int id = 0;
+    std::string_view side = "buy";
+    run(state, [&] {
+        lgr->info("order filled",
+                  tmb::kv("id", ++id),
+                  tmb::kv("px", 101.25),
+                  tmb::kv("side", side));
+    });
+}
+BENCHMARK(BM_NullSinkFields)->ArgName("json")->Arg(0)->Arg(1);
+
+// the same request id, prepended by hand on every call or set once as a
+// tmb::context
+void BM_NullSinkRequestId(benchmark::State& state) {
+    auto lgr        = null_logger();
+    std::string req = "7f3a9c2e";
+    if (state.range(0)) {
+        auto ctx = tmb::context("req_id", req);
+        run(state, [&] { lgr->info("order filled"); });
+    } else {
+        run(state, [&] { lgr->info("order filled", tmb::kv("req_id", req)); });
+    }
+}
+BENCHMARK(BM_NullSinkRequestId)->ArgName("context")->Arg(0)->Arg(1);
+
+// --- record rendering, as done by sinks ----------------------------------
+
+// bytes/line shows what the color escapes cost when the output isn't a
+// terminal: colors:0 is what an Auto sink renders into a pipe or file
+template <typename Setup>
+void render(benchmark::State& state, Setup&& setup) {
+    auto lgr  = null_logger();
+    auto sink = std::make_shared<RenderSink>(state.range(0) != 0);
+    lgr->add_sink(sink);
+    setup(*lgr);
+    int i = 0;
+    run(state, [&] { lgr->info("value {}", ++i); });
+    state.counters["bytes/line"] =
+            benchmark::Counter(static_cast<double>(sink->bytes),
+                               benchmark::Counter::kAvgIterations);
+}
+
+void BM_RenderDefaultLayout(benchmark::State& state) {
+    render(state, [](tmb::Logger&) {});
+}
+BENCHMARK(BM_RenderDefaultLayout)->ArgName("colors")->Arg(0);
+
+void BM_RenderStaticLayout(benchmark::State& state) {
+    render(state, [](tmb::Logger& lgr) {
+        lgr.set_layout<"{time}.{us} {color}{level:5}{reset} [{logger}] "
+                       "{file}:{line} {msg}\n">();
+    });
+}
+BENCHMARK(BM_RenderStaticLayout)->ArgName("colors")->Arg(0)->Arg(1);
+
+void BM_RenderRuntimeLayout(benchmark::State& state) {
+    render(state, [](tmb::Logger& lgr) {
+        lgr.set_layout("{time}.{us} {color}{level:5}{reset} [{logger}] "
+                       "{file}:{line} {msg}\n");
+    });
+}
+BENCHMARK(BM_RenderRuntimeLayout)->ArgName("colors")->Arg(0)->Arg(1);
+
+// --- async records longer than a queue cell -------------------------------
+
+void BM_AsyncLongMessage(benchmark::State& state) {
+    auto opts = tmb::AsyncOptions {
+        .arena_chunks = static_cast<std::size_t>(state.range(0)),
+    };
+    auto lgr = std::make_unique<tmb::Logger>("bench", bench_cfg, opts);
+    lgr->add_sink(std::make_shared<NullSink>());
+    auto str = std::string(1024, 'x');
+    run(state, [&] { lgr->info("value {}", str); });
+}
+BENCHMARK(BM_AsyncLongMessage)->ArgName("arena")->Arg(0)->Arg(1024);
+
+// --- batches, to a buffered file ------------------------------------------
+//
+// 64 records per iteration, logged one by one or through Logger::batch
+
+void buffered(benchmark::State& state, bool batched) {
+    auto lgr = tmb::Logger("bench", bench_cfg);
+    lgr.add_sink(std::make_shared<tmb::BufferedSink>(
+            "/dev/null", tmb::BufferOptions { .interval = {} }));
+    int i = 0;
+    run(state, [&] {
+        if (batched) {
+            auto batch = lgr.batch();
+            for (int n = 0; n < 64; ++n) batch.info("value {}", ++i);
+        } else {
+            for (int n = 0; n < 64; ++n) lgr.info("value {}", ++i);
+        }
+    });
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+
+void BM_BufferedLines(benchmark::State& state) { buffered(state, false); }
+BENCHMARK(BM_BufferedLines);
+
+void BM_BufferedBatch(benchmark::State& state) { buffered(state, true); }
+BENCHMARK(BM_BufferedBatch);
+
+// --- timber-c output (to /dev/null) ---------------------------------------
+
+void BM_TimberCLogger(benchmark::State& state) {
+    auto lgr = tmb::Logger("bench", bench_cfg);
+    int i    = 0;
+    run(state, [&] { lgr.info("value {}", ++i); });
+}
+BENCHMARK(BM_TimberCLogger);
+
+void BM_TimberCDefaultLogger(benchmark::State& state) {
+    tmb::set_level(tmb::LogLevel::Info);
+    int i = 0;
+    run(state, [&] { tmb::info("value {}", ++i); });
+}
+BENCHMARK(BM_TimberCDefaultLogger);
+
+// --- contention -----------------------------------------------------------
+//
+// One logger shared by all threads. items_per_second is the total throughput,
+// it should grow with the thread count for the per-thread queues (up to the
+// rate the single writer can drain them).
+
+std::unique_ptr<tmb::Logger> shared_logger;
+
+template <typename Make>
+void contended(benchmark::State& state, Make&& make) {
+    if (state.thread_index() == 0) shared_logger = make();
+    int i = 0;
+    run(state, [&] { shared_logger->info("value {}", ++i); });
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) shared_logger.reset();
+}
+
+void BM_ContendedNullSink(benchmark::State& state) {
+    contended(state, [] { return null_logger(); });
+}
+BENCHMARK(BM_ContendedNullSink)->ThreadRange(1, 64)->UseRealTime();
+
+void BM_ContendedAsync(benchmark::State& state) {
+    contended(state, [] { return async_null_logger(); });
+}
+BENCHMARK(BM_ContendedAsync)->ThreadRange(1, 64)->UseRealTime();
+
+void BM_ContendedAsyncPerThread(benchmark::State& state) {
+    contended(state, [] { return async_null_logger(true); });
+}
+BENCHMARK(BM_ContendedAsyncPerThread)->ThreadRange(1, 64)->UseRealTime();
+
+} // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    std::fflush(stdout);
+    int report_fd = ::dup(STDOUT_FILENO);
+    int null_fd   = ::open("/dev/null", O_WRONLY);
+    if (report_fd < 0 || null_fd < 0) return 1;
+    ::dup2(null_fd, STDOUT_FILENO);
+    ::close(null_fd);
+
+    std::ofstream report("/dev/fd/" + std::to_string(report_fd));
+    benchmark::ConsoleReporter reporter(benchmark::ConsoleReporter::OO_Tabular);
+    reporter.SetOutputStream(&report);
+    reporter.SetErrorStream(&std::cerr);
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+}
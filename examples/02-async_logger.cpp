@@ -0,0 +1,29 @@
+#include <tmb/tmb.hpp>
+
+#include <thread>
+#include <vector>
+
+int main(void) {
+    auto lgr = tmb::Logger("async",
+                           {
+                                   .log_level     = tmb::c::TMB_LOG_LEVEL_INFO,
+                                   .enable_colors = true,
+                           },
+                           tmb::AsyncOptions {
+                                   .capacity = 1024,
+                                   .overflow = tmb::OverflowPolicy::DropOldest,
+                           });
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&lgr, t] {
+            for (int i = 0; i < 1000; ++i) {
+                lgr.info("worker {} step {}", t, i);
+            }
+        });
+    }
+    for (auto& w : workers) { w.join(); }
+
+    lgr.flush();
+    lgr.warn("dropped {} records", lgr.dropped());
+}
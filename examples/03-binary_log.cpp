@@ -0,0 +1,13 @@
+#include <tmb/tmb.hpp>
+
+// Writes records in the binary format, read them back with
+//   tmb-decode example.tmbb
+int main(void) {
+    auto lgr = tmb::Logger("binary");
+    if (!lgr.set_binary_output("example.tmbb")) { return 1; }
+
+    for (int i = 0; i < 10; ++i) {
+        lgr.info("order {} filled at {:.2f}", i, 100.0 + i / 4.0);
+    }
+    lgr.warn("{} orders filled", 10);
+}
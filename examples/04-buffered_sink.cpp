@@ -0,0 +1,19 @@
+#include <tmb/sinks/buffered_sink.hpp>
+#include <tmb/tmb.hpp>
+
+#include <unistd.h>
+
+int main(void) {
+    auto lgr = tmb::Logger("buffered");
+    lgr.add_sink(std::make_shared<tmb::BufferedSink>(
+            STDOUT_FILENO,
+            tmb::BufferOptions {
+                    .size        = 16 * 1024,
+                    .interval    = std::chrono::milliseconds(50),
+                    .flush_level = tmb::LogLevel::Error,
+            }));
+    lgr.set_layout<"{time}.{us} {color}{level:5}{reset} [{logger}] {msg}\n">();
+
+    for (int i = 0; i < 1000; ++i) { lgr.info("line {}", i); }
+    lgr.error("errors are written out immediately");
+}
@@ -0,0 +1,20 @@
+#include <tmb/sinks/mmap_sink.hpp>
+
+#include <chrono>
+
+int main(void) {
+    auto lgr = tmb::Logger("mmap");
+    // segments go to example-mmap.log.0, example-mmap.log.1, ...
+    lgr.add_sink(std::make_shared<tmb::MmapSink>(
+            "example-mmap.log",
+            tmb::MmapOptions {
+                    .segment_size    = 1024 * 1024,
+                    .rotate_interval = std::chrono::seconds(60),
+                    .msync           = tmb::MsyncPolicy::OnRotate,
+            }));
+
+    for (int i = 0; i < 50000; ++i) {
+        lgr.info("record {}", i);
+    }
+    lgr.warn("done");
+}
@@ -0,0 +1,34 @@
+#include <tmb/sinks/async_sink.hpp>
+#include <tmb/sinks/buffered_sink.hpp>
+#include <tmb/tmb.hpp>
+
+#include <chrono>
+#include <thread>
+
+#include <unistd.h>
+
+// stands in for a network collector that can't keep up
+class SlowSink : public tmb::Sink {
+  public:
+    void write(const tmb::Record&) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+};
+
+int main(void) {
+    auto lgr  = tmb::Logger("fan-out");
+    auto slow = std::make_shared<tmb::AsyncSink>(
+            std::make_shared<SlowSink>(),
+            tmb::AsyncSinkOptions {
+                    .capacity = 64,
+                    .overflow = tmb::OverflowPolicy::DropOldest,
+            });
+    lgr.add_sink(std::make_shared<tmb::AsyncSink>(
+            std::make_shared<tmb::BufferedSink>(STDOUT_FILENO)));
+    lgr.add_sink(slow);
+
+    // the console gets every line, the slow sink whatever fits its queue
+    for (int i = 0; i < 1000; ++i) { lgr.info("line {}", i); }
+    lgr.flush();
+    lgr.info("slow sink dropped {} records", slow->dropped());
+}
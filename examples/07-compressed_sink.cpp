@@ -0,0 +1,24 @@
+#include <tmb/sinks/compressed_sink.hpp>
+#include <tmb/tmb.hpp>
+
+#include <cstdio>
+
+// needs -DTMB_WITH_ZSTD=ON, read the output with zstdcat compressed.*.zst
+int main(void) {
+    if constexpr (!tmb::compression_available(tmb::Compression::Zstd)) {
+        std::puts("built without zstd");
+        return 0;
+    }
+
+    auto lgr = tmb::Logger("compressed");
+    lgr.add_sink(std::make_shared<tmb::CompressedSink>(
+            "compressed",
+            tmb::CompressedOptions {
+                    .codec       = tmb::Compression::Zstd,
+                    .frame_size  = 256 * 1024,
+                    .rotate_size = 64 * 1024 * 1024,
+            }));
+
+    for (int i = 0; i < 100000; ++i) { lgr.info("row {} accepted", i); }
+    lgr.error("errors close the frame, the file is readable up to here");
+}
@@ -0,0 +1,84 @@
+#ifndef TMB_CPP_CRASH_HANDLER_HPP_
+#define TMB_CPP_CRASH_HANDLER_HPP_
+
+#include <tmb/tmb.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace tmb {
+
+// Writes out what the live loggers still hold: sink buffers go to their
+// files, queued async records to fd. Async-signal-safe, meant for fatal
+// signal handlers of your own; install_crash_handler() calls it for you.
+inline void emergency_flush(int fd = STDERR_FILENO) noexcept {
+    auto saved = errno;
+    internal::EmergencyRegistry::flush_all(fd);
+    errno = saved;
+}
+
+namespace internal {
+
+inline constexpr int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+                                         SIGABRT };
+
+struct CrashState {
+    std::atomic<int> fd { STDERR_FILENO };
+    std::atomic_flag flushed;
+    struct sigaction previous[std::size(crash_signals)];
+};
+
+inline constinit CrashState crash_state {};
+
+inline void crash_handler(int sig, siginfo_t*, void*) {
+    // a second crash while flushing goes straight to the previous handler
+    if (!crash_state.flushed.test_and_set()) {
+        emergency_flush(crash_state.fd.load(std::memory_order_relaxed));
+    }
+    for (std::size_t i = 0; i < std::size(crash_signals); ++i) {
+        if (crash_signals[i] == sig) {
+            ::sigaction(sig, &crash_state.previous[i], nullptr);
+        }
+    }
+    // delivered once the handler returns, to whatever was installed before
+    // (a fault re-triggers anyway when the instruction is retried)
+    ::raise(sig);
+}
+
+} // namespace internal
+
+// Installs handlers for SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT that
+// run emergency_flush(fd) and then hand the signal on to the handler that
+// was installed before, or the default action. The calling thread also gets
+// an alternate signal stack so a stack overflow can still be reported.
+// false if a handler couldn't be installed.
+inline bool install_crash_handler(int fd = STDERR_FILENO) noexcept {
+    internal::crash_state.fd.store(fd, std::memory_order_relaxed);
+
+    static char alt_stack[64 * 1024];
+    stack_t ss {};
+    ss.ss_sp   = alt_stack;
+    ss.ss_size = sizeof alt_stack;
+    ::sigaltstack(&ss, nullptr);
+
+    struct sigaction sa {};
+    sa.sa_sigaction = internal::crash_handler;
+    sa.sa_flags     = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    bool ok = true;
+    for (std::size_t i = 0; i < std::size(internal::crash_signals); ++i) {
+        ok &= ::sigaction(internal::crash_signals[i],
+                          &sa,
+                          &internal::crash_state.previous[i]) == 0;
+    }
+    return ok;
+}
+
+} // namespace tmb
+
+#endif // TMB_CPP_CRASH_HANDLER_HPP_
@@ -0,0 +1,43 @@
+#ifndef TMB_CPP_FWD_HPP_
+#define TMB_CPP_FWD_HPP_
+
+// Declarations of the public types and nothing else, for headers that only
+// pass loggers and sinks around. Logging through them needs <tmb/tmb.hpp>:
+// format strings are checked at compile time, and that takes <format>.
+// tmb.hpp includes this file, so the two can't drift apart.
+
+namespace tmb {
+
+enum class LogLevel : int;
+enum class OverflowPolicy;
+enum class FieldStyle;
+enum class ClockPolicy;
+enum class ColorMode;
+
+struct AsyncOptions;
+struct LoggerStats;
+struct Record;
+class SharedRecord;
+class Sink;
+class Layout;
+class Logger;
+class ScopedContext;
+
+// <tmb/span.hpp>
+class Span;
+
+// <tmb/sinks/...>
+struct BufferOptions;
+class BufferedSink;
+enum class MsyncPolicy;
+struct MmapOptions;
+class MmapSink;
+struct AsyncSinkOptions;
+class AsyncSink;
+enum class Compression;
+struct CompressedOptions;
+class CompressedSink;
+
+} // namespace tmb
+
+#endif // TMB_CPP_FWD_HPP_
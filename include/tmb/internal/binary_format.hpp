@@ -0,0 +1,94 @@
+#ifndef TMB_CPP_INTERNAL_BINARY_FORMAT_HPP_
+#define TMB_CPP_INTERNAL_BINARY_FORMAT_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Layout of the files written by Logger::set_binary_output and read by
+// tmb-decode. Integers are stored in host byte order, the decoder is meant to
+// run on the same kind of machine that wrote the log.
+//
+//   header  : "TMBB" u32 version, str logger name
+//   site    : 'S' u32 id, i32 line, str file, str function, str format
+//   record  : 'R' u32 site, u8 level, i64 sec, i64 nsec, u16 argc, args...
+//   message : 'M' u32 site, u8 level, i64 sec, i64 nsec, str message
+//   arg     : u8 type, then the value (str for strings, 8 bytes otherwise)
+//   str     : u32 length, bytes
+//
+// A site entry is written once, before the first record that refers to it.
+// Message entries carry text that was formatted when it was logged (runtime
+// format strings, arguments without a binary encoding).
+namespace tmb::internal::binary {
+
+inline constexpr char magic[4]        = { 'T', 'M', 'B', 'B' };
+inline constexpr std::uint32_t version = 1;
+
+enum class Entry : std::uint8_t {
+    Site    = 'S',
+    Record  = 'R',
+    Message = 'M',
+};
+
+enum class Arg : std::uint8_t {
+    Bool,
+    Char,
+    Int,
+    UInt,
+    Double,
+    String,
+    Pointer,
+};
+
+template <typename T>
+inline void put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void put_str(std::string& out, std::string_view str) {
+    put(out, static_cast<std::uint32_t>(str.size()));
+    out.append(str);
+}
+
+// Bounds-checked reading over a loaded file, any overrun marks the reader
+// as failed and yields zeroes.
+class Cursor {
+  public:
+    explicit Cursor(std::string_view data) : _data(data) {}
+
+    template <typename T>
+    T get() noexcept {
+        T value {};
+        if (!take(sizeof(T))) return value;
+        std::memcpy(&value, _data.data() + _pos - sizeof(T), sizeof(T));
+        return value;
+    }
+
+    std::string_view get_str() noexcept {
+        auto len = get<std::uint32_t>();
+        if (!take(len)) return {};
+        return _data.substr(_pos - len, len);
+    }
+
+    bool at_end() const noexcept { return _pos >= _data.size(); }
+    bool failed() const noexcept { return _failed; }
+
+  private:
+    bool take(std::size_t n) noexcept {
+        if (_failed || _data.size() - _pos < n) {
+            _failed = true;
+            return false;
+        }
+        _pos += n;
+        return true;
+    }
+
+    std::string_view _data;
+    std::size_t _pos { 0 };
+    bool _failed { false };
+};
+
+} // namespace tmb::internal::binary
+
+#endif // TMB_CPP_INTERNAL_BINARY_FORMAT_HPP_
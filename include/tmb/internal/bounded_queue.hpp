@@ -0,0 +1,118 @@
+#ifndef TMB_CPP_INTERNAL_BOUNDED_QUEUE_HPP_
+#define TMB_CPP_INTERNAL_BOUNDED_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace tmb::internal {
+
+inline constexpr std::size_t cache_line_size = 64;
+
+// Bounded lock-free queue (Vyukov). Every cell carries a sequence number
+// telling producers and consumers whose turn it is. Values are built and
+// read in place through callbacks, so a push/pop never copies a whole
+// record. Any thread may pop, the async logger relies on that to let
+// producers discard the oldest record when the queue is full.
+template <typename T>
+class BoundedQueue {
+  public:
+    explicit BoundedQueue(std::size_t capacity) :
+        _capacity(round_up_pow2(capacity)),
+        _mask(_capacity - 1),
+        _cells(std::make_unique<Cell[]>(_capacity)) {
+        for (std::size_t i = 0; i < _capacity; ++i) {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&)            = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // fill(T&) must not throw, it runs after the cell is reserved
+    template <typename Fill>
+    bool try_push(Fill&& fill) noexcept {
+        auto pos = _enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell     = &_cells[pos & _mask];
+            auto seq = cell->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) -
+                       static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (_enqueue_pos.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consume(T&) must not throw, the cell is handed back after it returns
+    template <typename Consume>
+    bool try_pop(Consume&& consume) noexcept {
+        auto pos = _dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell     = &_cells[pos & _mask];
+            auto seq = cell->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) -
+                       static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (_dequeue_pos.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        consume(cell->value);
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // number of pushes that have reserved a cell so far
+    std::size_t pushed() const noexcept {
+        return _enqueue_pos.load(std::memory_order_acquire);
+    }
+
+    // approximate, only meant for statistics
+    std::size_t size() const noexcept {
+        auto head = _dequeue_pos.load(std::memory_order_relaxed);
+        auto tail = _enqueue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    std::size_t capacity() const noexcept { return _capacity; }
+
+  private:
+    struct alignas(cache_line_size) Cell {
+        std::atomic<std::size_t> seq;
+        T value;
+    };
+
+    static std::size_t round_up_pow2(std::size_t n) noexcept {
+        std::size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    std::size_t _capacity;
+    std::size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    alignas(cache_line_size) std::atomic<std::size_t> _enqueue_pos { 0 };
+    alignas(cache_line_size) std::atomic<std::size_t> _dequeue_pos { 0 };
+};
+
+} // namespace tmb::internal
+
+#endif // TMB_CPP_INTERNAL_BOUNDED_QUEUE_HPP_
@@ -0,0 +1,147 @@
+#ifndef TMB_CPP_INTERNAL_CHUNK_POOL_HPP_
+#define TMB_CPP_INTERNAL_CHUNK_POOL_HPP_
+
+#include <tmb/internal/bounded_queue.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace tmb::internal {
+
+// A slab of fixed size chunks, preallocated once, for messages too long for
+// an async queue cell. Producers take chunks off a lock-free free list and
+// chain as many as a message needs, the writer thread puts the whole chain
+// back with a single CAS once the record is written. Nothing is allocated
+// after construction; when the slab runs dry store() fails and the caller
+// falls back to the heap. Every async queue has a pool of its own, with
+// per-thread queues the free list head is shared by one producer and the
+// writer only.
+class ChunkPool {
+  public:
+    static constexpr std::uint32_t none       = UINT32_MAX;
+    static constexpr std::size_t chunk_bytes  = 256;
+    static constexpr std::size_t chunk_header = 2 * sizeof(std::uint32_t);
+    static constexpr std::size_t payload      = chunk_bytes - chunk_header;
+
+    explicit ChunkPool(std::size_t chunks) :
+        _count(static_cast<std::uint32_t>(
+                chunks < none ? chunks : std::size_t { none - 1 })),
+        _chunks(std::make_unique<Chunk[]>(_count)) {
+        for (std::uint32_t i = 0; i < _count; ++i) {
+            _chunks[i].next.store(i + 1 < _count ? i + 1 : none,
+                                  std::memory_order_relaxed);
+        }
+        _free.store(pack(0, _count ? 0 : none), std::memory_order_relaxed);
+    }
+
+    ChunkPool(const ChunkPool&)            = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    // Copies msg into a chain of chunks, returns its first chunk or none if
+    // there aren't enough free ones
+    std::uint32_t store(std::string_view msg) noexcept {
+        std::uint32_t head = none;
+        Chunk* tail        = nullptr;
+        while (!msg.empty()) {
+            auto index = pop();
+            if (index == none) {
+                release(head);
+                return none;
+            }
+            auto& chunk = _chunks[index];
+            auto n      = msg.size() < payload ? msg.size() : payload;
+            std::memcpy(chunk.data, msg.data(), n);
+            chunk.size = static_cast<std::uint32_t>(n);
+            chunk.next.store(none, std::memory_order_relaxed);
+            msg.remove_prefix(n);
+            if (tail) {
+                tail->next.store(index, std::memory_order_relaxed);
+            } else {
+                head = index;
+            }
+            tail = &chunk;
+        }
+        return head;
+    }
+
+    // calls f(std::string_view) for each piece of the chain, in order
+    template <typename F>
+    void for_each(std::uint32_t head, F&& f) const noexcept {
+        for (auto i = head; i != none; i = next_of(i)) {
+            f(std::string_view(_chunks[i].data, _chunks[i].size));
+        }
+    }
+
+    void read(std::uint32_t head, std::string& out) const {
+        for_each(head, [&](std::string_view piece) { out.append(piece); });
+    }
+
+    // gives a whole chain back to the free list
+    void release(std::uint32_t head) noexcept {
+        if (head == none) return;
+        auto tail = head;
+        while (next_of(tail) != none) tail = next_of(tail);
+        auto seen = _free.load(std::memory_order_relaxed);
+        do {
+            _chunks[tail].next.store(index_of(seen), std::memory_order_relaxed);
+        } while (!_free.compare_exchange_weak(seen,
+                                              pack(tag_of(seen) + 1, head),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+  private:
+    struct alignas(cache_line_size) Chunk {
+        // the chain while in use, the free list otherwise
+        std::atomic<std::uint32_t> next { none };
+        std::uint32_t size { 0 };
+        char data[payload];
+    };
+    static_assert(sizeof(Chunk) == chunk_bytes);
+
+    // the free list head carries a tag bumped on every change, so a pop
+    // that raced with a pop and a push of the same chunk fails its CAS
+    static std::uint64_t pack(std::uint32_t tag, std::uint32_t index) noexcept {
+        return static_cast<std::uint64_t>(tag) << 32 | index;
+    }
+    static std::uint32_t tag_of(std::uint64_t v) noexcept {
+        return static_cast<std::uint32_t>(v >> 32);
+    }
+    static std::uint32_t index_of(std::uint64_t v) noexcept {
+        return static_cast<std::uint32_t>(v);
+    }
+
+    std::uint32_t next_of(std::uint32_t index) const noexcept {
+        return _chunks[index].next.load(std::memory_order_relaxed);
+    }
+
+    std::uint32_t pop() noexcept {
+        auto seen = _free.load(std::memory_order_acquire);
+        for (;;) {
+            auto index = index_of(seen);
+            if (index == none) return none;
+            // may read a chunk another producer just took, the CAS then
+            // fails on the tag
+            auto next = _chunks[index].next.load(std::memory_order_relaxed);
+            if (_free.compare_exchange_weak(seen,
+                                            pack(tag_of(seen) + 1, next),
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return index;
+            }
+        }
+    }
+
+    std::uint32_t _count;
+    std::unique_ptr<Chunk[]> _chunks;
+    alignas(cache_line_size) std::atomic<std::uint64_t> _free { 0 };
+};
+
+} // namespace tmb::internal
+
+#endif // TMB_CPP_INTERNAL_CHUNK_POOL_HPP_
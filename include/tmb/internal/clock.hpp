@@ -0,0 +1,172 @@
+#ifndef TMB_CPP_INTERNAL_CLOCK_HPP_
+#define TMB_CPP_INTERNAL_CLOCK_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+namespace tmb {
+
+// Where a Logger takes its record timestamps from
+enum class ClockPolicy {
+    // timber-c stamps synchronous records itself, queued records and
+    // records for sinks use Precise
+    Default,
+    // clock_gettime(CLOCK_REALTIME)
+    Precise,
+    // CLOCK_REALTIME_COARSE, a few ms resolution but no hardware clock read
+    Coarse,
+    // a process wide ticker thread refreshes the time every millisecond,
+    // a record only loads it
+    Cached,
+    // raw CPU cycle counter on the logging thread, converted to wall time
+    // where the record is written (the async writer thread, if any)
+    Tsc,
+};
+
+namespace internal {
+
+struct Timestamp {
+    std::int64_t sec  = 0;
+    std::int64_t nsec = 0;
+};
+
+inline constexpr std::int64_t ns_per_sec = 1'000'000'000;
+
+// Timestamp::sec value marking nsec as unconverted cycle counter ticks
+inline constexpr std::int64_t raw_cycles =
+        std::numeric_limits<std::int64_t>::min();
+
+inline Timestamp from_ns(std::int64_t ns) noexcept {
+    return { ns / ns_per_sec, ns % ns_per_sec };
+}
+
+inline Timestamp read_clock(clockid_t id) noexcept {
+    timespec ts {};
+    clock_gettime(id, &ts);
+    return { static_cast<std::int64_t>(ts.tv_sec),
+             static_cast<std::int64_t>(ts.tv_nsec) };
+}
+
+inline Timestamp wall_clock_now() noexcept {
+    return read_clock(CLOCK_REALTIME);
+}
+
+inline Timestamp coarse_clock_now() noexcept {
+#ifdef CLOCK_REALTIME_COARSE
+    return read_clock(CLOCK_REALTIME_COARSE);
+#else
+    return read_clock(CLOCK_REALTIME);
+#endif
+}
+
+// trivially destructible so records logged during static destruction can
+// still read it
+inline constinit std::atomic<std::int64_t> cached_clock_ns { 0 };
+
+inline Timestamp cached_clock_now() noexcept {
+    struct Ticker {
+        std::jthread thread;
+
+        Ticker() {
+            auto now = wall_clock_now();
+            cached_clock_ns.store(now.sec * ns_per_sec + now.nsec,
+                                  std::memory_order_relaxed);
+            thread = std::jthread([](std::stop_token stop) {
+                while (!stop.stop_requested()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    auto t = wall_clock_now();
+                    cached_clock_ns.store(t.sec * ns_per_sec + t.nsec,
+                                          std::memory_order_relaxed);
+                }
+            });
+        }
+    };
+    static Ticker ticker;
+    return from_ns(cached_clock_ns.load(std::memory_order_relaxed));
+}
+
+inline std::uint64_t read_cycles() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return static_cast<std::uint64_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Maps cycle counter ticks to wall time. Measured once, over a few
+// milliseconds, the first time a Tsc logger is set up.
+struct CycleCalibration {
+    std::uint64_t anchor_cycles;
+    std::int64_t anchor_ns;
+    double ns_per_cycle;
+
+    static const CycleCalibration& get() {
+        static const CycleCalibration calibration = measure();
+        return calibration;
+    }
+
+    Timestamp to_wall(std::uint64_t cycles) const noexcept {
+        auto delta = static_cast<double>(static_cast<std::int64_t>(
+                cycles - anchor_cycles));
+        return from_ns(anchor_ns +
+                       static_cast<std::int64_t>(delta * ns_per_cycle));
+    }
+
+  private:
+    static std::int64_t to_ns(Timestamp t) noexcept {
+        return t.sec * ns_per_sec + t.nsec;
+    }
+
+    static CycleCalibration measure() {
+        auto c0 = read_cycles();
+        auto t0 = to_ns(wall_clock_now());
+        std::int64_t t1;
+        std::uint64_t c1;
+        do {
+            c1 = read_cycles();
+            t1 = to_ns(wall_clock_now());
+        } while (t1 - t0 < 5'000'000);
+        return { c1,
+                 t1,
+                 static_cast<double>(t1 - t0) /
+                         static_cast<double>(c1 - c0 ? c1 - c0 : 1) };
+    }
+};
+
+inline Timestamp clock_now(ClockPolicy policy) noexcept {
+    switch (policy) {
+    case ClockPolicy::Coarse: return coarse_clock_now();
+    case ClockPolicy::Cached: return cached_clock_now();
+    case ClockPolicy::Tsc:
+        return { raw_cycles, static_cast<std::int64_t>(read_cycles()) };
+    case ClockPolicy::Default:
+    case ClockPolicy::Precise:
+    default: return wall_clock_now();
+    }
+}
+
+// turns whatever clock_now() returned into wall time
+inline Timestamp resolve_time(Timestamp ts) noexcept {
+    if (ts.sec != raw_cycles) return ts;
+    auto cycles = static_cast<std::uint64_t>(ts.nsec);
+    return CycleCalibration::get().to_wall(cycles);
+}
+
+} // namespace internal
+} // namespace tmb
+
+#endif // TMB_CPP_INTERNAL_CLOCK_HPP_
@@ -0,0 +1,176 @@
+#ifndef TMB_CPP_INTERNAL_CORE_IMPL_HPP_
+#define TMB_CPP_INTERNAL_CORE_IMPL_HPP_
+
+// The logging core declared in tmb.hpp, which includes this at its end:
+// inline in header-only builds, compiled once into timber-cpp-compiled with
+// TMB_COMPILED_LIB. Everything here sees arguments only as std::format_args
+// or as a formatted message.
+
+namespace tmb {
+
+namespace internal {
+
+_tmb_ccp_CORE__ std::string_view vformat_message(MessageBuffer& buf,
+                                                 LogLevel& level,
+                                                 std::string_view fmt,
+                                                 std::format_args args) {
+    auto& out = buf.str();
+    try {
+        std::vformat_to(std::back_inserter(out), fmt, args);
+    } catch (const std::format_error& e) {
+        out.assign("[format error] ");
+        out.append(e.what());
+        level = LogLevel::Error;
+        buf.set_failed();
+    }
+    return out;
+}
+
+_tmb_ccp_CORE__ void log_default_logger_impl(LogLevel level,
+                                             const SourceMeta& meta,
+                                             std::string_view msg) {
+    emit(nullptr, LogContext(level, meta).to_c(), msg);
+}
+
+_tmb_ccp_CORE__ void log_default_elapsed(LogLevel level,
+                                         const SourceMeta& meta,
+                                         std::string_view name,
+                                         std::chrono::nanoseconds elapsed) {
+    auto& stats = default_logger_stats();
+    stats.emitted(static_cast<int>(level));
+    MessageBuffer buf;
+    format_elapsed(buf.str(), name, elapsed);
+    append_context(buf.str(), FieldStyle::Logfmt, false);
+    stats.formatted(buf.str().size(), false);
+    emit(nullptr,
+         LogContext(level, meta, {}, from_ns(elapsed.count())).to_c(),
+         buf.str());
+}
+
+_tmb_ccp_CORE__ void vlog_default_logger(LogLevel level,
+                                         const SourceMeta& meta,
+                                         std::string_view fmt,
+                                         std::format_args args) {
+    auto& stats = default_logger_stats();
+    stats.emitted(static_cast<int>(level));
+    MessageBuffer buf;
+    vformat_message(buf, level, fmt, args);
+    append_context(buf.str(), FieldStyle::Logfmt, false);
+    stats.formatted(buf.str().size(), buf.failed());
+    log_default_logger_impl(level, meta, buf.str());
+}
+
+} // namespace internal
+
+_tmb_ccp_CORE__ Logger::Logger(std::string_view name,
+                               const c::tmb_logger_cfg_t& cfg) :
+    _level(static_cast<int>(cfg.log_level)) {
+    // level filtering is done on the C++ side before formatting, so the C
+    // logger lets everything through. Colors are only worth their bytes on
+    // a terminal, decided here once for timber-c's stdout.
+    auto c_cfg          = cfg;
+    c_cfg.log_level     = static_cast<c::tmb_log_level>(LogLevel::All);
+    c_cfg.enable_colors = cfg.enable_colors &&
+                          internal::colors_wanted(STDOUT_FILENO);
+    _logger             = c::tmb_logger_create(name.data(), c_cfg);
+    if (!_logger) { throw std::runtime_error("Failed to create logger"); }
+    _name = std::string(name);
+    _out  = std::make_unique<internal::Dispatcher>(_logger, _name);
+}
+
+_tmb_ccp_CORE__ Logger::Logger(std::string_view name,
+                               const c::tmb_logger_cfg_t& cfg,
+                               const AsyncOptions& async) :
+    Logger(name, cfg) {
+    _async = std::make_unique<internal::AsyncWorker>(_out.get(), async);
+}
+
+_tmb_ccp_CORE__ Logger::~Logger() {
+    // _async stays set until its writer is gone, a sink may log through us
+    if (_async) _async->stop();
+    _async.reset();
+    if (_logger) {
+        c::tmb_logger_destroy(_logger);
+        _logger = nullptr;
+    }
+}
+
+_tmb_ccp_CORE__ void Logger::flush() noexcept {
+    auto start = std::chrono::steady_clock::now();
+    if (_async) _async->flush();
+    if (_binary) _binary->flush();
+    _out->flush();
+    _out->stats().flushed(std::chrono::steady_clock::now() - start);
+}
+
+_tmb_ccp_CORE__ void Logger::log_elapsed(LogLevel level,
+                                         const internal::SourceMeta& meta,
+                                         std::string_view name,
+                                         std::chrono::nanoseconds elapsed) {
+    _out->stats().emitted(static_cast<int>(level));
+    internal::MessageBuffer buf;
+    internal::format_elapsed(buf.str(), name, elapsed);
+    internal::append_context(buf.str(), field_style(), false);
+    _out->stats().formatted(buf.str().size(), false);
+    log_impl(level, meta, buf.str(), internal::from_ns(elapsed.count()));
+}
+
+_tmb_ccp_CORE__ void Logger::vformat_and_write(
+        LogLevel level,
+        const internal::SourceMeta& meta,
+        std::string_view fmt,
+        std::format_args args) {
+    internal::MessageBuffer buf;
+    internal::vformat_message(buf, level, fmt, args);
+    internal::append_context(buf.str(), field_style(), false);
+    _out->stats().formatted(buf.str().size(), buf.failed());
+    log_impl(level, meta, buf.str());
+}
+
+_tmb_ccp_CORE__ void Logger::log_impl(LogLevel level,
+                                      const internal::SourceMeta& meta,
+                                      std::string_view msg,
+                                      internal::Timestamp stopwatch) {
+    if (_binary) {
+        _binary->write_message(level, meta, stamp(true), msg);
+    } else if (_async) {
+        _async->push(level, meta, stamp(true), msg, stopwatch);
+    } else {
+        _out->write(level, meta, stamp(_out->has_sinks()), msg, stopwatch);
+    }
+    // the process is likely about to go down, don't leave anything queued
+    // or buffered behind
+    if (level == LogLevel::Fatal) flush();
+}
+
+_tmb_ccp_CORE__ void Logger::Batch::submit() noexcept {
+    auto& records = _buf->records;
+    auto& text    = _buf->text;
+    if (records.empty()) return;
+    auto& lgr  = *_logger;
+    bool fatal = false;
+    for (const auto& r : records) fatal |= r.level == LogLevel::Fatal;
+    if (lgr._binary) {
+        for (const auto& r : records) {
+            try {
+                lgr._binary->write_message(
+                        r.level,
+                        r.meta,
+                        r.ts,
+                        std::string_view(text).substr(r.offset, r.size));
+            } catch (...) {
+            }
+        }
+    } else if (lgr._async) {
+        lgr._async->push_batch(records, text);
+    } else {
+        lgr._out->write_batch(records, text);
+    }
+    records.clear();
+    text.clear();
+    if (fatal) lgr.flush();
+}
+
+} // namespace tmb
+
+#endif // TMB_CPP_INTERNAL_CORE_IMPL_HPP_
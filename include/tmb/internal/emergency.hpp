@@ -0,0 +1,158 @@
+#ifndef TMB_CPP_INTERNAL_EMERGENCY_HPP_
+#define TMB_CPP_INTERNAL_EMERGENCY_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <thread>
+
+#include <unistd.h>
+
+namespace tmb::internal {
+
+// Something holding records that haven't reached their destination yet.
+// emergency_flush runs in a fatal signal handler, possibly while other
+// threads keep logging: only async-signal-safe calls, no locks that may be
+// held, no allocation.
+class EmergencyFlush {
+  public:
+    virtual void emergency_flush(int fd) noexcept = 0;
+
+  protected:
+    ~EmergencyFlush() = default;
+};
+
+// Fixed table of live EmergencyFlush objects, walked in registration order
+// by tmb::emergency_flush. Registering past the table size just leaves the
+// object out. A walk marks the slot it's calling through as in use, and
+// remove() waits for that to end, so its object can be destroyed right
+// after: a crash while a logger shuts down never reaches a freed one.
+class EmergencyRegistry {
+  public:
+    static constexpr std::size_t slots = 256;
+
+    static int add(EmergencyFlush* target) noexcept {
+        for (std::size_t i = 0; i < slots; ++i) {
+            EmergencyFlush* empty = nullptr;
+            if (_targets[i].compare_exchange_strong(
+                        empty, target, std::memory_order_release)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // Either a walk sees the slot empty, or this sees it in use and waits.
+    // Not from inside an emergency_flush, the walk holds its slot.
+    static void remove(int slot) noexcept {
+        if (slot < 0) return;
+        _targets[slot].store(nullptr, std::memory_order_seq_cst);
+        while (_users[slot].load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    static void flush_all(int fd) noexcept {
+        for (std::size_t i = 0; i < slots; ++i) {
+            _users[i].fetch_add(1, std::memory_order_seq_cst);
+            if (auto* target = _targets[i].load(std::memory_order_seq_cst)) {
+                target->emergency_flush(fd);
+            }
+            _users[i].fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+  private:
+    static inline constinit std::atomic<EmergencyFlush*> _targets[slots] {};
+    // walks calling through each slot right now
+    static inline constinit std::atomic<std::uint32_t> _users[slots] {};
+};
+
+// Builds output on the stack and write(2)s it out whenever it fills up
+class EmergencyWriter {
+  public:
+    explicit EmergencyWriter(int fd) noexcept : _fd(fd) {}
+    ~EmergencyWriter() { flush(); }
+
+    EmergencyWriter(const EmergencyWriter&)            = delete;
+    EmergencyWriter& operator=(const EmergencyWriter&) = delete;
+
+    void append(std::string_view s) noexcept {
+        while (!s.empty()) {
+            if (_size == sizeof _buf) flush();
+            auto n = s.size() < sizeof _buf - _size ? s.size()
+                                                     : sizeof _buf - _size;
+            std::memcpy(_buf + _size, s.data(), n);
+            _size += n;
+            s.remove_prefix(n);
+        }
+    }
+
+    void append(std::int64_t v) noexcept {
+        if (v < 0) {
+            append(std::string_view("-"));
+            append(0 - static_cast<std::uint64_t>(v));
+        } else {
+            append(static_cast<std::uint64_t>(v));
+        }
+    }
+
+    void append(std::uint64_t v) noexcept {
+        char digits[20];
+        char* p = digits + sizeof digits;
+        do {
+            *--p = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v);
+        append(std::string_view(
+                p, static_cast<std::size_t>(digits + sizeof digits - p)));
+    }
+
+    // fixed, six decimals, good enough for a crash report
+    void append(double v) noexcept {
+        if (v != v) return append(std::string_view("nan"));
+        if (v < 0) {
+            append(std::string_view("-"));
+            v = -v;
+        }
+        if (v > 1e18) return append(std::string_view("inf"));
+        auto whole = static_cast<std::uint64_t>(v);
+        auto frac  = static_cast<std::uint64_t>(
+                (v - static_cast<double>(whole)) * 1e6 + 0.5);
+        if (frac >= 1000000) {
+            ++whole;
+            frac -= 1000000;
+        }
+        append(whole);
+        char digits[7] = { '.' };
+        for (int i = 6; i > 0; --i, frac /= 10) {
+            digits[i] = static_cast<char>('0' + frac % 10);
+        }
+        append(std::string_view(digits, sizeof digits));
+    }
+
+    void flush() noexcept {
+        std::size_t done = 0;
+        while (done < _size) {
+            auto n = ::write(_fd, _buf + done, _size - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        _size = 0;
+    }
+
+  private:
+    int _fd;
+    std::size_t _size { 0 };
+    char _buf[4096];
+};
+
+} // namespace tmb::internal
+
+#endif // TMB_CPP_INTERNAL_EMERGENCY_HPP_
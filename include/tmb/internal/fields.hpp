@@ -0,0 +1,195 @@
+#ifndef TMB_CPP_INTERNAL_FIELDS_HPP_
+#define TMB_CPP_INTERNAL_FIELDS_HPP_
+
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace tmb {
+
+// How key/value fields are appended to the message
+enum class FieldStyle {
+    // msg id=42 px=101.5 side="buy now"
+    Logfmt,
+    // msg {"id":42,"px":101.5,"side":"buy now"}
+    Json,
+};
+
+// A structured field, passed after the format arguments:
+//
+//   lgr.info("order filled", tmb::kv("id", id), tmb::kv("px", px));
+//
+// Only references the value, it's rendered before the log call returns.
+template <typename T>
+struct Field {
+    std::string_view key;
+    const T& value;
+};
+
+template <typename T>
+Field<T> kv(std::string_view key, const T& value) noexcept {
+    return { key, value };
+}
+
+namespace internal {
+
+template <typename T>
+struct is_field : std::false_type {};
+
+template <typename T>
+struct is_field<Field<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_field_v = is_field<std::remove_cvref_t<T>>::value;
+
+// number of format arguments, i.e. arguments before the first field
+template <typename... Args>
+inline constexpr std::size_t message_arg_count = [] {
+    std::size_t n = 0;
+    bool field    = false;
+    ((field = field || is_field_v<Args>, n += field ? 0 : 1), ...);
+    return n;
+}();
+
+template <typename... Args>
+inline constexpr bool fields_trailing =
+        ((is_field_v<Args> ? 1 : 0) + ... + 0) ==
+        sizeof...(Args) - message_arg_count<Args...>;
+
+// std::format_string for the arguments without the fields
+template <typename List, typename... Args>
+struct message_format;
+
+template <typename... Out>
+struct message_format<void(Out...)> {
+    using type = std::format_string<Out...>;
+};
+
+template <typename... Out, typename T, typename... Rest>
+struct message_format<void(Out...), T, Rest...> :
+    std::conditional_t<is_field_v<T>,
+                       message_format<void(Out...), Rest...>,
+                       message_format<void(Out..., T), Rest...>> {};
+
+template <typename... Args>
+using message_format_string = typename message_format<void(), Args...>::type;
+
+template <typename T>
+concept field_string = std::convertible_to<const T&, std::string_view> &&
+                       !std::same_as<std::remove_cvref_t<T>, std::nullptr_t>;
+
+inline bool logfmt_needs_quotes(std::string_view s) noexcept {
+    if (s.empty()) return true;
+    for (char ch : s) {
+        auto c = static_cast<unsigned char>(ch);
+        if (c <= ' ' || c == '"' || c == '=' || c == '\\' || c == 0x7f)
+            return true;
+    }
+    return false;
+}
+
+// quoted and escaped, valid both as a logfmt and as a JSON string
+inline void append_quoted(std::string& out, std::string_view s) {
+    out.push_back('"');
+    for (char ch : s) {
+        auto c = static_cast<unsigned char>(ch);
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if (c < 0x20) {
+                char esc[8];
+                std::snprintf(esc, sizeof esc, "\\u%04x", c);
+                out.append(esc);
+            } else {
+                out.push_back(ch);
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+// Formats value at the end of out and quotes it afterwards if the style
+// needs it. Only values that do need quoting are copied once more.
+template <typename T>
+void append_formatted(std::string& out, const T& value, bool always_quote) {
+    auto start = out.size();
+    std::format_to(std::back_inserter(out), "{}", value);
+    auto text = std::string_view(out).substr(start);
+    if (!always_quote && !logfmt_needs_quotes(text)) return;
+    std::string raw(text);
+    out.resize(start);
+    append_quoted(out, raw);
+}
+
+inline void append_string(std::string& out, bool json, std::string_view s) {
+    if (json || logfmt_needs_quotes(s)) {
+        append_quoted(out, s);
+    } else {
+        out.append(s);
+    }
+}
+
+template <typename T>
+void append_value(std::string& out, FieldStyle style, const T& value) {
+    bool json = style == FieldStyle::Json;
+    if constexpr (std::same_as<T, bool>) {
+        out.append(value ? "true" : "false");
+    } else if constexpr (std::same_as<T, char>) {
+        append_string(out, json, std::string_view(&value, 1));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        // JSON has no representation for these
+        if (json && !std::isfinite(value)) {
+            out.append("null");
+        } else {
+            std::format_to(std::back_inserter(out), "{}", value);
+        }
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        std::format_to(std::back_inserter(out), "{}", value);
+    } else if constexpr (field_string<T>) {
+        append_string(out, json, value);
+    } else {
+        append_formatted(out, value, json);
+    }
+}
+
+template <typename... Ts>
+void render_fields(std::string& out,
+                   FieldStyle style,
+                   const Field<Ts>&... fields) {
+    if (style == FieldStyle::Json) {
+        out.append(" {");
+        bool first = true;
+        auto one   = [&](auto key, const auto& value) {
+            if (!first) out.push_back(',');
+            first = false;
+            append_quoted(out, key);
+            out.push_back(':');
+            append_value(out, style, value);
+        };
+        (one(fields.key, fields.value), ...);
+        out.push_back('}');
+    } else {
+        auto one = [&](auto key, const auto& value) {
+            out.push_back(' ');
+            out.append(key);
+            out.push_back('=');
+            append_value(out, style, value);
+        };
+        (one(fields.key, fields.value), ...);
+    }
+}
+
+} // namespace internal
+} // namespace tmb
+
+#endif // TMB_CPP_INTERNAL_FIELDS_HPP_
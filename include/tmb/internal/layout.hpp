@@ -0,0 +1,233 @@
+#ifndef TMB_CPP_INTERNAL_LAYOUT_HPP_
+#define TMB_CPP_INTERNAL_LAYOUT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+namespace tmb::internal {
+
+// A string literal usable as a template argument: set_layout<"...">()
+template <std::size_t N>
+struct fixed_string {
+    char data[N] {};
+
+    constexpr fixed_string(const char (&s)[N]) {
+        for (std::size_t i = 0; i < N; ++i) data[i] = s[i];
+    }
+
+    constexpr std::string_view view() const noexcept {
+        return { data, N - 1 };
+    }
+};
+
+enum class LayoutField : std::uint8_t {
+    Literal,
+    Date,       // 2026-01-31, local time
+    Time,       // 12:00:00
+    Millis,     // 123
+    Micros,     // 123456
+    Nanos,      // 123456789
+    Epoch,      // seconds since the epoch
+    Level,      // INFO
+    LevelColor, // color escape for the level
+    Logger,
+    File,       // base name
+    Path,       // as passed by the compiler
+    Line,
+    Func,
+    Message,
+    Thread,     // name from set_thread_name, the id for unnamed threads
+    Tid,        // kernel thread id
+};
+
+// One step of a compiled layout. Literals (colors included) are merged, so
+// the static text between two fields is a single copy.
+struct LayoutOp {
+    LayoutField field = LayoutField::Literal;
+    // literal: length, field: minimum width, left aligned
+    std::uint32_t width = 0;
+    // literal: position in the literal buffer
+    std::uint32_t offset = 0;
+};
+
+struct LayoutName {
+    std::string_view name;
+    LayoutField field;
+};
+
+inline constexpr LayoutName layout_fields[] = {
+    { "date", LayoutField::Date },       { "time", LayoutField::Time },
+    { "ms", LayoutField::Millis },       { "us", LayoutField::Micros },
+    { "ns", LayoutField::Nanos },        { "epoch", LayoutField::Epoch },
+    { "level", LayoutField::Level },     { "color", LayoutField::LevelColor },
+    { "logger", LayoutField::Logger },   { "file", LayoutField::File },
+    { "path", LayoutField::Path },       { "line", LayoutField::Line },
+    { "func", LayoutField::Func },       { "msg", LayoutField::Message },
+    { "thread", LayoutField::Thread },   { "tid", LayoutField::Tid },
+};
+
+struct LayoutColor {
+    std::string_view name;
+    std::string_view code;
+};
+
+inline constexpr LayoutColor layout_colors[] = {
+    { "reset", "\033[0m" },   { "bold", "\033[1m" },
+    { "dim", "\033[2m" },     { "red", "\033[31m" },
+    { "green", "\033[32m" },  { "yellow", "\033[33m" },
+    { "blue", "\033[34m" },   { "magenta", "\033[35m" },
+    { "cyan", "\033[36m" },   { "white", "\033[37m" },
+    { "gray", "\033[90m" },
+};
+
+// Fixed capacity program, for patterns compiled at compile time. A pattern
+// of n chars never needs more than n ops or n literal chars.
+template <std::size_t N>
+struct StaticLayoutProgram {
+    LayoutOp ops[N + 1] {};
+    char chars[N + 1] {};
+    std::size_t op_count   = 0;
+    std::size_t char_count = 0;
+    bool ok                = false;
+
+    constexpr void push_op(LayoutOp op) { ops[op_count++] = op; }
+    constexpr void push_char(char c) { chars[char_count++] = c; }
+    constexpr LayoutOp* last_op() {
+        return op_count ? &ops[op_count - 1] : nullptr;
+    }
+    constexpr std::size_t literal_size() const { return char_count; }
+};
+
+struct LayoutProgram {
+    std::vector<LayoutOp> ops;
+    std::string chars;
+
+    void push_op(LayoutOp op) { ops.push_back(op); }
+    void push_char(char c) { chars.push_back(c); }
+    LayoutOp* last_op() { return ops.empty() ? nullptr : &ops.back(); }
+    std::size_t literal_size() const { return chars.size(); }
+};
+
+template <typename Program>
+constexpr void layout_literal(Program& out, std::string_view text) {
+    if (text.empty()) return;
+    auto* last = out.last_op();
+    if (!last || last->field != LayoutField::Literal) {
+        out.push_op({ LayoutField::Literal,
+                      0,
+                      static_cast<std::uint32_t>(out.literal_size()) });
+        last = out.last_op();
+    }
+    for (char c : text) out.push_char(c);
+    last->width += static_cast<std::uint32_t>(text.size());
+}
+
+// string_view::find isn't usable in constant expressions under GCC's
+// -fsanitize=undefined, patterns are scanned by hand
+constexpr std::size_t layout_find(std::string_view s,
+                                  std::size_t from,
+                                  char a,
+                                  char b = '\0') noexcept {
+    for (auto i = from; i < s.size(); ++i) {
+        if (s[i] == a || (b && s[i] == b)) return i;
+    }
+    return std::string_view::npos;
+}
+
+// Pattern syntax:
+//
+//   "{date} {time}.{ms} {level:5} [{logger}] {file}:{line} {msg}\n"
+//
+// {name} is a record field, {name:N} pads it to at least N chars, {red},
+// {bold}, {reset}... are ANSI escapes and {color} is the one for the
+// record's level. {{ and }} are literal braces. false for unknown names and
+// unbalanced braces.
+//
+// Without colors the escapes are left out of the program altogether, the
+// pattern is still checked the same way.
+template <typename Program>
+constexpr bool parse_layout(std::string_view pattern,
+                            Program& out,
+                            bool colors = true) {
+    std::size_t i = 0;
+    while (i < pattern.size()) {
+        char c = pattern[i];
+        if (c == '}') {
+            if (i + 1 >= pattern.size() || pattern[i + 1] != '}') return false;
+            layout_literal(out, "}");
+            i += 2;
+            continue;
+        }
+        if (c != '{') {
+            auto next = layout_find(pattern, i, '{', '}');
+            if (next == std::string_view::npos) next = pattern.size();
+            layout_literal(out, pattern.substr(i, next - i));
+            i = next;
+            continue;
+        }
+        if (i + 1 < pattern.size() && pattern[i + 1] == '{') {
+            layout_literal(out, "{");
+            i += 2;
+            continue;
+        }
+        auto close = layout_find(pattern, i, '}');
+        if (close == std::string_view::npos) return false;
+        auto spec = pattern.substr(i + 1, close - i - 1);
+        i         = close + 1;
+
+        std::uint32_t width = 0;
+        if (auto colon = layout_find(spec, 0, ':');
+            colon != std::string_view::npos) {
+            auto digits = spec.substr(colon + 1);
+            if (digits.empty() || digits.size() > 4) return false;
+            for (char d : digits) {
+                if (d < '0' || d > '9') return false;
+                width = width * 10 + static_cast<std::uint32_t>(d - '0');
+            }
+            spec = spec.substr(0, colon);
+        }
+
+        bool found = false;
+        for (const auto& color : layout_colors) {
+            if (color.name == spec && width == 0) {
+                if (colors) layout_literal(out, color.code);
+                found = true;
+            }
+        }
+        for (const auto& field : layout_fields) {
+            if (field.name == spec) {
+                if (colors || field.field != LayoutField::LevelColor) {
+                    out.push_op({ field.field, width, 0 });
+                }
+                found = true;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+// Whether output to fd should be colored: a terminal that isn't "dumb",
+// unless NO_COLOR is set (https://no-color.org). FORCE_COLOR turns colors
+// on regardless, e.g. for CI log viewers that understand them.
+inline bool colors_wanted(int fd) noexcept {
+    auto set = [](const char* name) {
+        auto* value = std::getenv(name);
+        return value && *value;
+    };
+    if (set("NO_COLOR")) return false;
+    if (set("FORCE_COLOR")) return true;
+    if (!::isatty(fd)) return false;
+    auto* term = std::getenv("TERM");
+    return !term || std::string_view(term) != "dumb";
+}
+
+} // namespace tmb::internal
+
+#endif // TMB_CPP_INTERNAL_LAYOUT_HPP_
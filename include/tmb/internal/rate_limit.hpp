@@ -0,0 +1,153 @@
+#ifndef TMB_CPP_INTERNAL_RATE_LIMIT_HPP_
+#define TMB_CPP_INTERNAL_RATE_LIMIT_HPP_
+
+#include <tmb/internal/bounded_queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace tmb::internal {
+
+// State of one rate limited call site
+struct alignas(cache_line_size) SiteLimit {
+    std::atomic<std::uint64_t> key { 0 };
+    std::atomic<std::uint64_t> calls { 0 };
+    std::atomic<std::int64_t> next_ns { 0 };
+    // sites that found no free slot, pushed onto their home slot
+    std::atomic<SiteLimit*> chain { nullptr };
+    // not in the table, see SiteLimits
+    bool overflow { false };
+};
+
+// Call sites are found by hashing their source location into a fixed,
+// process wide table. Slots are claimed with a CAS and never released, so
+// lookups don't lock and don't allocate. A site whose probes are all taken
+// gets a node of its own, allocated once and chained off its home slot, and
+// found by walking that chain from then on. If even that allocation fails
+// the site shares one spill slot with every other such site: they are
+// limited together, more than they asked for, but never not at all.
+class SiteLimits {
+  public:
+    static constexpr std::size_t slots  = 1024;
+    static constexpr std::size_t probes = 16;
+
+    static SiteLimit& find(const void* file,
+                           const void* func,
+                           int line,
+                           int column) noexcept {
+        static SiteLimit table[slots];
+
+        auto key = hash(file, func, line, column);
+        for (std::size_t i = 0; i < probes; ++i) {
+            auto& slot = table[(key + i) & (slots - 1)];
+            auto seen  = slot.key.load(std::memory_order_acquire);
+            if (seen == 0 && slot.key.compare_exchange_strong(
+                                     seen, key, std::memory_order_acq_rel))
+                return slot;
+            // seen now holds whoever owns the slot
+            if (seen == key) return slot;
+        }
+        return chained(table[key & (slots - 1)], key);
+    }
+
+  private:
+    static SiteLimit* search(SiteLimit* from,
+                             const SiteLimit* to,
+                             std::uint64_t key) noexcept {
+        for (; from != to; from = from->chain.load(std::memory_order_acquire))
+            if (from->key.load(std::memory_order_relaxed) == key) return from;
+        return nullptr;
+    }
+
+    // nodes are never freed, like the table
+    static SiteLimit& chained(SiteLimit& home, std::uint64_t key) noexcept {
+        auto* head = home.chain.load(std::memory_order_acquire);
+        if (auto* found = search(head, nullptr, key)) return *found;
+
+        auto* node = new (std::nothrow) SiteLimit;
+        if (!node) return spill();
+        node->key.store(key, std::memory_order_relaxed);
+        node->overflow = true;
+        for (;;) {
+            node->chain.store(head, std::memory_order_relaxed);
+            auto* seen = head;
+            if (home.chain.compare_exchange_weak(
+                        head, node, std::memory_order_acq_rel))
+                return *node;
+            // another thread may have pushed this very site meanwhile
+            if (auto* found = search(head, seen, key)) {
+                delete node;
+                return *found;
+            }
+        }
+    }
+
+    static SiteLimit& spill() noexcept {
+        static SiteLimit slot { .overflow = true };
+        return slot;
+    }
+
+    // one to one in h for a given v, so sites differing in one field only
+    // can't collide
+    static std::uint64_t mix(std::uint64_t h, std::uint64_t v) noexcept {
+        h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+        return h ^ (h >> 29);
+    }
+
+    static std::uint64_t hash(const void* file,
+                              const void* func,
+                              int line,
+                              int column) noexcept {
+        std::uint64_t h = reinterpret_cast<std::uintptr_t>(file);
+        h = mix(h, reinterpret_cast<std::uintptr_t>(func));
+        h = mix(h, static_cast<std::uint32_t>(line));
+        h = mix(h, static_cast<std::uint32_t>(column));
+        // the table index comes from the low bits
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        // zero marks a free slot
+        return h ? h : 1;
+    }
+};
+
+// true for the 1st, (n+1)th, (2n+1)th... call through the site
+inline bool every_n(SiteLimit& site, std::uint64_t n) noexcept {
+    auto call = site.calls.fetch_add(1, std::memory_order_relaxed);
+    return n <= 1 || call % n == 0;
+}
+
+// true at most once per period, the first caller after it has elapsed wins
+inline bool every(SiteLimit& site, std::chrono::nanoseconds period) noexcept {
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+    auto next = site.next_ns.load(std::memory_order_relaxed);
+    if (now < next) return false;
+    return site.next_ns.compare_exchange_strong(
+            next, now + period.count(), std::memory_order_relaxed);
+}
+
+// true with probability p, from a per thread generator (splitmix64)
+inline bool sampled(double p) noexcept {
+    if (p >= 1.0) return true;
+    if (!(p > 0.0)) return false;
+    thread_local std::uint64_t state =
+            reinterpret_cast<std::uintptr_t>(&state) ^
+            static_cast<std::uint64_t>(std::chrono::steady_clock::now()
+                                               .time_since_epoch()
+                                               .count());
+    auto z = (state += 0x9e3779b97f4a7c15ull);
+    z      = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z      = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    // top 53 bits as a double in [0, 1)
+    return static_cast<double>(z >> 11) * 0x1.0p-53 < p;
+}
+
+} // namespace tmb::internal
+
+#endif // TMB_CPP_INTERNAL_RATE_LIMIT_HPP_
@@ -0,0 +1,278 @@
+#ifndef TMB_CPP_INTERNAL_STATS_HPP_
+#define TMB_CPP_INTERNAL_STATS_HPP_
+
+#include <tmb/internal/bounded_queue.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tmb {
+
+// Latencies in power of two buckets: bucket i counts samples of
+// [2^i, 2^(i+1)) ns, bucket 0 also the ones under a nanosecond
+struct LatencyHistogram {
+    static constexpr std::size_t buckets = 40; // the last one is ~18 min
+
+    std::array<std::uint64_t, buckets> counts {};
+
+    std::uint64_t count() const noexcept {
+        std::uint64_t n = 0;
+        for (auto c : counts) n += c;
+        return n;
+    }
+
+    // upper bound of the bucket holding the p quantile, zero without samples
+    std::chrono::nanoseconds percentile(double p) const noexcept {
+        auto total = count();
+        if (total == 0) return {};
+        auto rank = static_cast<std::uint64_t>(
+                std::clamp(p, 0.0, 1.0) * static_cast<double>(total - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < buckets; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return std::chrono::nanoseconds(std::int64_t { 2 } << i);
+            }
+        }
+        return std::chrono::nanoseconds(std::int64_t { 1 } << buckets);
+    }
+};
+
+struct LevelCounts {
+    // passed the level check and handed to the output
+    std::uint64_t emitted = 0;
+    // stopped by the level check, only counted with TMB_COUNT_FILTERED
+    std::uint64_t filtered = 0;
+};
+
+// A reading of one logger's counters, see Logger::stats and tmb::stats.
+// Each counter is exact, but counters read while other threads log aren't
+// from a single instant.
+struct LoggerStats {
+    std::string name;
+    // indexed by LogLevel: levels[static_cast<int>(LogLevel::Info)]
+    std::array<LevelCounts, 8> levels {};
+    // records that failed to format and were logged as [format error]
+    std::uint64_t format_errors = 0;
+    // bytes of formatted messages (binary output isn't counted)
+    std::uint64_t bytes = 0;
+    // records discarded by the async overflow policy
+    std::uint64_t dropped = 0;
+    // rate limited calls from a site that didn't fit the site table, and
+    // had to be looked up on a slower path
+    std::uint64_t site_overflows = 0;
+    // most records seen waiting in one async queue
+    std::uint64_t queue_high_water = 0;
+    // Logger::flush calls, explicit or after a fatal record
+    LatencyHistogram flush_latency;
+
+    std::uint64_t emitted() const noexcept {
+        std::uint64_t n = 0;
+        for (const auto& l : levels) n += l.emitted;
+        return n;
+    }
+
+    std::uint64_t filtered() const noexcept {
+        std::uint64_t n = 0;
+        for (const auto& l : levels) n += l.filtered;
+        return n;
+    }
+};
+
+namespace internal {
+
+struct alignas(cache_line_size) StatsBlock {
+    std::atomic<std::uint64_t> emitted[8] {};
+    std::atomic<std::uint64_t> filtered[8] {};
+    std::atomic<std::uint64_t> format_errors { 0 };
+    std::atomic<std::uint64_t> bytes { 0 };
+    std::atomic<std::uint64_t> site_overflows { 0 };
+    // the thread that writes to it, a new thread may take over an old id's
+    std::thread::id owner;
+};
+
+// A logger's counters. Every thread that logs gets a block of its own on its
+// first record, so an update is a relaxed add to a line no other thread
+// writes to; reading sums the blocks. Blocks stay when their thread exits,
+// with its counts. The rare events (drops, flushes) aren't per thread.
+class StatsCounters {
+  public:
+    void emitted(int level) noexcept {
+        block().emitted[slot(level)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void filtered(int level) noexcept {
+        block().filtered[slot(level)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void formatted(std::size_t bytes, bool failed) noexcept {
+        auto& b = block();
+        b.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (failed) b.format_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void site_overflow() noexcept {
+        block().site_overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void dropped() noexcept {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t drops() const noexcept {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    void queue_depth(std::size_t depth) noexcept {
+        auto seen = _high_water.load(std::memory_order_relaxed);
+        while (depth > seen &&
+               !_high_water.compare_exchange_weak(
+                       seen, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    void flushed(std::chrono::nanoseconds took) noexcept {
+        auto ns     = static_cast<std::uint64_t>(std::max<std::int64_t>(
+                took.count(), 1));
+        auto bucket = std::min<std::size_t>(
+                static_cast<std::size_t>(std::bit_width(ns)) - 1,
+                LatencyHistogram::buckets - 1);
+        _flush[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void read(LoggerStats& out) const noexcept {
+        auto add = [&out](const StatsBlock& b) {
+            for (std::size_t i = 0; i < out.levels.size(); ++i) {
+                out.levels[i].emitted +=
+                        b.emitted[i].load(std::memory_order_relaxed);
+                out.levels[i].filtered +=
+                        b.filtered[i].load(std::memory_order_relaxed);
+            }
+            out.format_errors +=
+                    b.format_errors.load(std::memory_order_relaxed);
+            out.bytes += b.bytes.load(std::memory_order_relaxed);
+            out.site_overflows +=
+                    b.site_overflows.load(std::memory_order_relaxed);
+        };
+        add(_shared);
+        {
+            std::lock_guard lock(_mutex);
+            for (const auto& b : _blocks) add(*b);
+        }
+        out.dropped          = drops();
+        out.queue_high_water = _high_water.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < LatencyHistogram::buckets; ++i) {
+            out.flush_latency.counts[i] =
+                    _flush[i].load(std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    static std::size_t slot(int level) noexcept {
+        return static_cast<std::size_t>(level) & 7;
+    }
+
+    // the calling thread's block: a lookup in a small per thread cache, keyed
+    // by an id no other StatsCounters ever gets
+    StatsBlock& block() noexcept {
+        struct Cached {
+            std::uint64_t id { 0 };
+            StatsBlock* block { nullptr };
+        };
+        thread_local std::array<Cached, 16> cache;
+        auto& c = cache[_id & (cache.size() - 1)];
+        if (c.id != _id) c = { _id, &attach() };
+        return *c.block;
+    }
+
+    // Finds the block this thread had before it dropped out of the cache, or
+    // takes the one of an exited thread that had the same id, or makes one.
+    // Shares _shared if that fails, its counts are still summed.
+    StatsBlock& attach() noexcept {
+        auto self = std::this_thread::get_id();
+        std::lock_guard lock(_mutex);
+        for (auto& b : _blocks) {
+            if (b->owner == self) return *b;
+        }
+        try {
+            _blocks.push_back(std::make_unique<StatsBlock>());
+        } catch (...) {
+            return _shared;
+        }
+        _blocks.back()->owner = self;
+        return *_blocks.back();
+    }
+
+    static std::uint64_t next_id() noexcept {
+        static std::atomic<std::uint64_t> next { 1 };
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::uint64_t _id = next_id();
+    mutable std::mutex _mutex; // guards _blocks
+    std::vector<std::unique_ptr<StatsBlock>> _blocks;
+    StatsBlock _shared;
+    alignas(cache_line_size) std::atomic<std::uint64_t> _dropped { 0 };
+    std::atomic<std::uint64_t> _high_water { 0 };
+    std::atomic<std::uint64_t> _flush[LatencyHistogram::buckets] {};
+};
+
+// The live loggers' counters, for tmb::stats
+class StatsRegistry {
+  public:
+    static void add(const std::string& name, const StatsCounters& counters) {
+        auto& s = state();
+        std::lock_guard lock(s.mutex);
+        s.entries.push_back({ &name, &counters });
+    }
+
+    static void remove(const StatsCounters& counters) noexcept {
+        auto& s = state();
+        std::lock_guard lock(s.mutex);
+        std::erase_if(s.entries,
+                      [&](const Entry& e) { return e.counters == &counters; });
+    }
+
+    static std::vector<LoggerStats> read() {
+        auto& s = state();
+        std::lock_guard lock(s.mutex);
+        std::vector<LoggerStats> out(s.entries.size());
+        for (std::size_t i = 0; i < out.size(); ++i) {
+            out[i].name = *s.entries[i].name;
+            s.entries[i].counters->read(out[i]);
+        }
+        return out;
+    }
+
+  private:
+    struct Entry {
+        const std::string* name;
+        const StatsCounters* counters;
+    };
+
+    struct State {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+    };
+
+    // never destroyed, loggers in other statics may go away after it would
+    static State& state() {
+        static State* s = new State;
+        return *s;
+    }
+};
+
+} // namespace internal
+} // namespace tmb
+
+#endif // TMB_CPP_INTERNAL_STATS_HPP_
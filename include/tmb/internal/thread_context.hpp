@@ -0,0 +1,197 @@
+#ifndef TMB_CPP_INTERNAL_THREAD_CONTEXT_HPP_
+#define TMB_CPP_INTERNAL_THREAD_CONTEXT_HPP_
+
+#include <tmb/internal/fields.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+    #include <sys/syscall.h>
+#endif
+
+namespace tmb {
+namespace internal {
+
+// A thread as records refer to it. Interned and never freed, so a record
+// can carry a pointer to it past the thread's exit, e.g. in an async queue.
+struct ThreadInfo {
+    int tid = 0;
+    std::string name;
+};
+
+inline int current_tid() noexcept {
+#ifdef __linux__
+    return static_cast<int>(::syscall(SYS_gettid));
+#else
+    return static_cast<int>(
+            std::hash<std::thread::id> {}(std::this_thread::get_id()));
+#endif
+}
+
+// One ThreadInfo per (tid, name). Kernel ids get reused, so the table is
+// bounded by the threads alive at once and the names they use.
+class ThreadRegistry {
+  public:
+    // nullptr if it couldn't be allocated
+    static const ThreadInfo* get(int tid, std::string_view name) noexcept {
+        auto& s = state();
+        try {
+            auto key = std::to_string(tid);
+            key.push_back('\0');
+            key.append(name);
+            std::lock_guard lock(s.mutex);
+            auto& info = s.threads[key];
+            if (!info) {
+                info = std::make_unique<const ThreadInfo>(
+                        ThreadInfo { tid, std::string(name) });
+            }
+            return info.get();
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+  private:
+    struct State {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<const ThreadInfo>>
+                threads;
+    };
+
+    // never destroyed, records may point into it until the very end
+    static State& state() {
+        static State* s = new State;
+        return *s;
+    }
+};
+
+// Per thread: who it is and its tmb::context fields, rendered once in each
+// field style when they're pushed
+struct ThreadContext {
+    const ThreadInfo* info = nullptr;
+    std::string logfmt; // " req_id=42 user=ann"
+    std::string json;   // "\"req_id\":42,\"user\":\"ann\""
+};
+
+inline ThreadContext& thread_context() noexcept {
+    thread_local ThreadContext ctx;
+    return ctx;
+}
+
+// looked up once per thread, the id is cached with it
+inline const ThreadInfo* current_thread() noexcept {
+    auto& ctx = thread_context();
+    if (!ctx.info) ctx.info = ThreadRegistry::get(current_tid(), {});
+    return ctx.info;
+}
+
+inline bool has_context() noexcept {
+    return !thread_context().logfmt.empty();
+}
+
+// Appends the calling thread's context fields to a message. In JSON they
+// join the object render_fields just closed, if there is one.
+inline void append_context(std::string& out, FieldStyle style, bool fields) {
+    const auto& ctx = thread_context();
+    if (ctx.logfmt.empty()) return;
+    if (style == FieldStyle::Logfmt) {
+        out.append(ctx.logfmt);
+        return;
+    }
+    if (fields && !out.empty() && out.back() == '}') {
+        out.back() = ',';
+    } else {
+        out.append(" {");
+    }
+    out.append(ctx.json);
+    out.push_back('}');
+}
+
+} // namespace internal
+
+// Names the calling thread in records ({thread} in layouts) and for the OS,
+// where it's cut to 15 chars
+inline void set_thread_name(std::string_view name) {
+    auto& ctx = internal::thread_context();
+    if (auto* info = internal::ThreadRegistry::get(internal::current_tid(),
+                                                   name)) {
+        ctx.info = info;
+    }
+#ifdef __linux__
+    char os_name[16] {};
+    name.copy(os_name, sizeof os_name - 1);
+    ::pthread_setname_np(::pthread_self(), os_name);
+#endif
+}
+
+// empty until set_thread_name
+inline std::string_view thread_name() noexcept {
+    auto* info = internal::current_thread();
+    return info ? std::string_view(info->name) : std::string_view();
+}
+
+// A field added to every record the calling thread logs while it's alive:
+//
+//   auto ctx = tmb::context("req_id", req.id);
+//   lgr.info("accepted");   // accepted req_id=7f3a
+//
+// The value is rendered when the context is made, a record only copies the
+// rendered text. Contexts nest and must end in reverse order, which scopes
+// take care of. Fields of records formatted on another thread (deferred
+// async records, binary output) would miss them, those records are
+// formatted on the calling thread while a context is open.
+class [[nodiscard]] ScopedContext {
+  public:
+    template <typename T>
+    ScopedContext(std::string_view key, const T& value) {
+        auto& ctx = internal::thread_context();
+        _logfmt   = ctx.logfmt.size();
+        _json     = ctx.json.size();
+        try {
+            ctx.logfmt.push_back(' ');
+            ctx.logfmt.append(key);
+            ctx.logfmt.push_back('=');
+            internal::append_value(ctx.logfmt, FieldStyle::Logfmt, value);
+            if (_json) ctx.json.push_back(',');
+            internal::append_quoted(ctx.json, key);
+            ctx.json.push_back(':');
+            internal::append_value(ctx.json, FieldStyle::Json, value);
+        } catch (...) {
+            end();
+            throw;
+        }
+    }
+
+    ~ScopedContext() { end(); }
+
+    ScopedContext(const ScopedContext&)            = delete;
+    ScopedContext& operator=(const ScopedContext&) = delete;
+
+  private:
+    void end() noexcept {
+        auto& ctx = internal::thread_context();
+        ctx.logfmt.resize(_logfmt);
+        ctx.json.resize(_json);
+    }
+
+    std::size_t _logfmt;
+    std::size_t _json;
+};
+
+template <typename T>
+ScopedContext context(std::string_view key, const T& value) {
+    return ScopedContext(key, value);
+}
+
+} // namespace tmb
+
+#endif // TMB_CPP_INTERNAL_THREAD_CONTEXT_HPP_
@@ -0,0 +1,202 @@
+#ifndef TMB_CPP_LEVEL_RELOAD_HPP_
+#define TMB_CPP_LEVEL_RELOAD_HPP_
+
+#include <tmb/registry.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace tmb {
+
+namespace internal {
+
+inline std::optional<LogLevel> parse_level(std::string_view name) noexcept {
+    auto is = [&](std::string_view want) {
+        if (name.size() != want.size()) return false;
+        for (std::size_t i = 0; i < want.size(); ++i) {
+            auto c = name[i];
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            if (c != want[i]) return false;
+        }
+        return true;
+    };
+    if (is("none")) return LogLevel::None;
+    if (is("fatal")) return LogLevel::Fatal;
+    if (is("error")) return LogLevel::Error;
+    if (is("warn") || is("warning")) return LogLevel::Warning;
+    if (is("info")) return LogLevel::Info;
+    if (is("debug")) return LogLevel::Debug;
+    if (is("trace")) return LogLevel::Trace;
+    if (is("all")) return LogLevel::All;
+    return std::nullopt;
+}
+
+inline std::string_view trim(std::string_view s) noexcept {
+    auto space = [](char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    };
+    while (!s.empty() && space(s.front())) s.remove_prefix(1);
+    while (!s.empty() && space(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+} // namespace internal
+
+// Applies a level spec: entries "prefix=level" separated by commas or
+// newlines, lines starting with '#' are skipped. A bare level (or an empty
+// prefix) applies to every registered logger and the default logger.
+//
+//   =info,net.=debug,db=warn
+//
+// Entries are applied in order through set_levels. false if any entry
+// couldn't be parsed, the others are applied anyway.
+inline bool apply_level_spec(std::string_view spec) {
+    bool ok = true;
+    while (!spec.empty()) {
+        auto end   = spec.find_first_of(",\n");
+        auto entry = internal::trim(spec.substr(0, end));
+        spec.remove_prefix(end == std::string_view::npos ? spec.size()
+                                                          : end + 1);
+        if (entry.empty() || entry.front() == '#') continue;
+
+        std::string_view prefix;
+        auto eq = entry.rfind('=');
+        if (eq != std::string_view::npos) {
+            prefix = internal::trim(entry.substr(0, eq));
+            entry  = internal::trim(entry.substr(eq + 1));
+        }
+        auto level = internal::parse_level(entry);
+        if (!level) {
+            ok = false;
+            continue;
+        }
+        if (prefix.empty()) set_level(*level);
+        set_levels(prefix, *level);
+    }
+    return ok;
+}
+
+namespace internal {
+
+// A SIGHUP only writes a byte to a pipe, the levels are reloaded on a
+// thread of our own where locking and allocating are fine.
+class LevelReloader {
+  public:
+    LevelReloader(std::string path, std::string env) :
+        _path(std::move(path)), _env(std::move(env)) {
+        if (::pipe(_pipe) != 0) {
+            throw std::runtime_error("Failed to create reload pipe");
+        }
+        ::fcntl(_pipe[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(_pipe[1], F_SETFD, FD_CLOEXEC);
+        ::fcntl(_pipe[1], F_SETFL, O_NONBLOCK);
+        pipe_fd().store(_pipe[1], std::memory_order_release);
+        _thread = std::jthread([this](std::stop_token stop) {
+            std::stop_callback wake(stop, [this] { poke(_pipe[1]); });
+            char c;
+            while (!stop.stop_requested()) {
+                auto n = ::read(_pipe[0], &c, 1);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0 || stop.stop_requested()) break;
+                reload();
+            }
+        });
+    }
+
+    ~LevelReloader() {
+        pipe_fd().store(-1, std::memory_order_release);
+        _thread.request_stop();
+        _thread.join();
+        ::close(_pipe[0]);
+        ::close(_pipe[1]);
+    }
+
+    LevelReloader(const LevelReloader&)            = delete;
+    LevelReloader& operator=(const LevelReloader&) = delete;
+
+    // the environment first, then the file, so the file wins
+    bool reload() {
+        bool ok = true;
+        if (!_env.empty()) {
+            if (auto* spec = std::getenv(_env.c_str())) {
+                ok &= apply_level_spec(spec);
+            }
+        }
+        if (!_path.empty()) {
+            std::ifstream file(_path);
+            if (!file) return false;
+            std::string spec((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+            ok &= apply_level_spec(spec);
+        }
+        return ok;
+    }
+
+    static void on_signal(int) {
+        auto saved = errno;
+        poke(pipe_fd().load(std::memory_order_acquire));
+        errno = saved;
+    }
+
+  private:
+    static std::atomic<int>& pipe_fd() noexcept {
+        static std::atomic<int> fd { -1 };
+        return fd;
+    }
+
+    static void poke(int fd) noexcept {
+        if (fd < 0) return;
+        char c = 1;
+        // a full pipe already has a reload pending
+        [[maybe_unused]] auto n = ::write(fd, &c, 1);
+    }
+
+    std::string _path;
+    std::string _env;
+    int _pipe[2] { -1, -1 };
+    std::jthread _thread;
+};
+
+} // namespace internal
+
+// Applies the level spec (see apply_level_spec) from the environment
+// variable env and then from the file at path, now and again on every
+// SIGHUP. Pass nullptr or "" to skip either source. Calling it again
+// replaces the sources. false if the initial load failed or the handler
+// couldn't be installed.
+inline bool reload_levels_on_sighup(const char* path,
+                                    const char* env = "TMB_LEVELS") {
+    static std::unique_ptr<internal::LevelReloader> reloader;
+    static std::mutex mutex;
+    std::lock_guard lock(mutex);
+    reloader.reset();
+    reloader = std::make_unique<internal::LevelReloader>(path ? path : "",
+                                                         env ? env : "");
+    bool ok = reloader->reload();
+
+    struct sigaction sa {};
+    sa.sa_handler = internal::LevelReloader::on_signal;
+    sa.sa_flags   = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    return ::sigaction(SIGHUP, &sa, nullptr) == 0 && ok;
+}
+
+} // namespace tmb
+
+#endif // TMB_CPP_LEVEL_RELOAD_HPP_
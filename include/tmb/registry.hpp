@@ -0,0 +1,134 @@
+#ifndef TMB_CPP_REGISTRY_HPP_
+#define TMB_CPP_REGISTRY_HPP_
+
+#include <tmb/tmb.hpp>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tmb {
+
+namespace internal {
+
+struct NameHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view name) const noexcept {
+        return std::hash<std::string_view> {}(name);
+    }
+};
+
+// Process wide name -> Logger map. Lookups only take a shared lock on one
+// of the shards, so threads looking up different (or the same) names don't
+// serialize; the exclusive lock is only taken to create a logger.
+class Registry {
+  public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    std::shared_ptr<Logger> get(std::string_view name,
+                                const c::tmb_logger_cfg_t& cfg) {
+        auto& shard = shard_for(name);
+        {
+            std::shared_lock lock(shard.mutex);
+            auto it = shard.loggers.find(name);
+            if (it != shard.loggers.end()) return it->second;
+        }
+        // created outside the shard lock, timber-c may take its time
+        auto logger = std::make_shared<Logger>(name, cfg);
+        std::unique_lock lock(shard.mutex);
+        auto [it, inserted] = shard.loggers.try_emplace(std::string(name),
+                                                        std::move(logger));
+        // under the shard lock, so a concurrent set_levels either sees the
+        // logger or its rule is seen here
+        if (inserted) apply_rules(*it->second);
+        return it->second;
+    }
+
+    void set_levels(std::string_view prefix, LogLevel level) {
+        {
+            std::lock_guard lock(_rules_mutex);
+            // a rule for a shorter prefix overrides the longer ones under it
+            std::erase_if(_rules, [&](const Rule& r) {
+                return r.prefix.starts_with(prefix);
+            });
+            _rules.push_back({ std::string(prefix), level });
+        }
+        for (auto& shard : _shards) {
+            std::shared_lock lock(shard.mutex);
+            for (auto& [name, logger] : shard.loggers) {
+                if (name.starts_with(prefix)) logger->set_level(level);
+            }
+        }
+    }
+
+  private:
+    struct Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string,
+                           std::shared_ptr<Logger>,
+                           NameHash,
+                           std::equal_to<>>
+                loggers;
+    };
+
+    struct Rule {
+        std::string prefix;
+        LogLevel level;
+    };
+
+    static constexpr std::size_t shard_count = 16;
+
+    Shard& shard_for(std::string_view name) noexcept {
+        return _shards[NameHash {}(name) % shard_count];
+    }
+
+    // rules are kept oldest first, the last matching one is the newest
+    void apply_rules(Logger& logger) {
+        std::lock_guard lock(_rules_mutex);
+        for (auto& rule : _rules) {
+            if (logger.name().starts_with(rule.prefix)) {
+                logger.set_level(rule.level);
+            }
+        }
+    }
+
+    std::array<Shard, shard_count> _shards;
+    std::mutex _rules_mutex;
+    std::vector<Rule> _rules;
+};
+
+} // namespace internal
+
+// The logger registered under name, created with cfg the first time the
+// name is asked for (cfg is ignored afterwards). All callers share the one
+// Logger and its timber-c handle. Keep the pointer around rather than
+// looking the name up on every call.
+inline std::shared_ptr<Logger> get_logger(
+        std::string_view name,
+        const c::tmb_logger_cfg_t& cfg = {
+                .log_level     = c::TMB_LOG_LEVEL_DEBUG,
+                .enable_colors = true,
+        }) {
+    return internal::Registry::instance().get(name, cfg);
+}
+
+// Sets the level of every registered logger whose name starts with prefix,
+// and of those registered later. An empty prefix matches all of them.
+//
+//   tmb::set_levels("net.", tmb::LogLevel::Debug);
+inline void set_levels(std::string_view prefix, LogLevel level) {
+    internal::Registry::instance().set_levels(prefix, level);
+}
+
+} // namespace tmb
+
+#endif // TMB_CPP_REGISTRY_HPP_
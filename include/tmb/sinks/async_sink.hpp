@@ -0,0 +1,204 @@
+#ifndef TMB_CPP_SINKS_ASYNC_SINK_HPP_
+#define TMB_CPP_SINKS_ASYNC_SINK_HPP_
+
+#include <tmb/internal/bounded_queue.hpp>
+#include <tmb/tmb.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace tmb {
+
+struct AsyncSinkOptions {
+    std::size_t capacity    = 8192; // records, rounded up to a power of two
+    OverflowPolicy overflow = OverflowPolicy::Block;
+};
+
+// Gives a sink its own queue and writer thread. A logger fanning out to
+// several of these hands each the same SharedRecord, so a slow destination
+// (a network collector, say) only fills its own queue and applies its own
+// overflow policy, the producer and the other sinks don't wait for it:
+//
+//   lgr.add_sink(std::make_shared<tmb::AsyncSink>(file_sink));
+//   lgr.add_sink(std::make_shared<tmb::AsyncSink>(
+//           net_sink, tmb::AsyncSinkOptions { .capacity = 1024,
+//                     .overflow = tmb::OverflowPolicy::DropOldest }));
+//
+// The wrapped sink is only ever written from the writer thread. flush()
+// waits for what was queued before it, then flushes the wrapped sink.
+class AsyncSink : public Sink, public internal::EmergencyFlush {
+  public:
+    explicit AsyncSink(std::shared_ptr<Sink> sink, AsyncSinkOptions opts = {}) :
+        _sink(std::move(sink)),
+        _overflow(opts.overflow),
+        _queue(opts.capacity) {
+        if (!_sink) { throw std::invalid_argument("AsyncSink needs a sink"); }
+        _thread = std::thread([this] { run(); });
+        _slot   = internal::EmergencyRegistry::add(this);
+    }
+
+    ~AsyncSink() override {
+        internal::EmergencyRegistry::remove(_slot);
+        _stop.store(true, std::memory_order_release);
+        wake();
+        _thread.join();
+        try {
+            _sink->flush();
+        } catch (...) {
+        }
+    }
+
+    AsyncSink(const AsyncSink&)            = delete;
+    AsyncSink& operator=(const AsyncSink&) = delete;
+
+    // for use outside a logger's fan-out, copies the record
+    void write(const Record& rec) override {
+        write_shared(std::make_shared<const SharedRecord>(rec));
+    }
+
+    bool shares_records() const noexcept override { return true; }
+
+    void write_shared(std::shared_ptr<const SharedRecord> rec) override {
+        // the copy in the cell can't throw, it's a reference count bump
+        auto fill = [&](Entry& cell) noexcept { cell = rec; };
+        while (!_queue.try_push(fill)) {
+            if (_overflow == OverflowPolicy::DropNewest) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else if (_overflow == OverflowPolicy::DropOldest) {
+                Entry old;
+                if (_queue.try_pop([&](Entry& cell) noexcept {
+                        old = std::move(cell);
+                    })) {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    _retired.fetch_add(1, std::memory_order_release);
+                }
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        notify();
+    }
+
+    // returns once everything queued before the call has been written and
+    // the wrapped sink flushed
+    void flush() override {
+        auto target = _queue.pushed();
+        wake();
+        while (_retired.load(std::memory_order_acquire) < target) {
+            std::this_thread::yield();
+        }
+        _sink->flush();
+    }
+
+    // the wrapped sink writes out what it has buffered, the queued records
+    // go to tmb::emergency_flush's fd (the overload below)
+    void emergency_flush() noexcept override { _sink->emergency_flush(); }
+
+    // Takes the queued records out from under the writer thread and writes
+    // them to fd as "LEVEL [logger] file:line message", like an async
+    // logger's: the wrapped sink's rendering isn't signal-safe. The cells
+    // keep their references, dropping the last one would free the record.
+    void emergency_flush(int fd) noexcept override {
+        internal::EmergencyWriter out(fd);
+        auto write = [&](Entry& cell) noexcept {
+            const auto& rec = cell->record();
+            out.append(internal::level_name(rec.level()));
+            out.append(" [");
+            out.append(rec.logger);
+            out.append("] ");
+            out.append(std::string_view(
+                    rec.ctx.filename_base,
+                    static_cast<std::size_t>(rec.ctx.filename_base_len)));
+            out.append(":");
+            out.append(static_cast<std::int64_t>(rec.ctx.line_no));
+            out.append(" ");
+            out.append(rec.message());
+            out.append("\n");
+        };
+        while (_queue.try_pop(write)) {
+            _retired.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // records discarded by the overflow policy
+    std::uint64_t dropped() const noexcept {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    const std::shared_ptr<Sink>& sink() const noexcept { return _sink; }
+
+  private:
+    using Entry = std::shared_ptr<const SharedRecord>;
+
+    void run() noexcept {
+        for (;;) {
+            if (drain() > 0) continue;
+            if (_stop.load(std::memory_order_acquire)) {
+                if (drain() == 0) break;
+                continue;
+            }
+            wait_for_work();
+        }
+    }
+
+    std::size_t drain() noexcept {
+        std::size_t n = 0;
+        Entry rec;
+        while (_queue.try_pop(
+                [&](Entry& cell) noexcept { rec = std::move(cell); })) {
+            // a failing sink loses the record, not the writer thread
+            try {
+                _sink->write(rec->record());
+            } catch (...) {
+            }
+            // the last reference may be this one, drop it before retiring
+            // so a flush() returning means the record is gone too
+            rec.reset();
+            _retired.fetch_add(1, std::memory_order_release);
+            ++n;
+        }
+        return n;
+    }
+
+    // same handshake as the async logger's writer, see AsyncWorker
+    void wait_for_work() noexcept {
+        auto signal = _signal.load(std::memory_order_acquire);
+        _sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_queue.size() == 0 && !_stop.load(std::memory_order_relaxed)) {
+            _signal.wait(signal, std::memory_order_acquire);
+        }
+        _sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    void notify() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleeping.load(std::memory_order_relaxed)) { wake(); }
+    }
+
+    void wake() noexcept {
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_one();
+    }
+
+    std::shared_ptr<Sink> _sink;
+    OverflowPolicy _overflow;
+    internal::BoundedQueue<Entry> _queue;
+    alignas(internal::cache_line_size) std::atomic<std::size_t> _retired { 0 };
+    std::atomic<std::uint64_t> _dropped { 0 };
+    alignas(internal::cache_line_size) std::atomic<std::uint32_t> _signal { 0 };
+    std::atomic<bool> _sleeping { false };
+    std::atomic<bool> _stop { false };
+    std::thread _thread;
+    int _slot { -1 };
+};
+
+} // namespace tmb
+
+#endif // TMB_CPP_SINKS_ASYNC_SINK_HPP_
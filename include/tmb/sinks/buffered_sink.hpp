@@ -0,0 +1,235 @@
+#ifndef TMB_CPP_SINKS_BUFFERED_SINK_HPP_
+#define TMB_CPP_SINKS_BUFFERED_SINK_HPP_
+
+#include <tmb/tmb.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace tmb {
+
+struct BufferOptions {
+    // flush once this many bytes are buffered
+    std::size_t size = 64 * 1024;
+    // flush at least this often, zero leaves it to size, level and flush()
+    std::chrono::milliseconds interval { 100 };
+    // records at this level or more severe are written out right away
+    LogLevel flush_level = LogLevel::Error;
+    // color escapes of the logger's layout, Auto keeps them for terminals
+    ColorMode colors = ColorMode::Auto;
+};
+
+namespace internal {
+
+// write(2) until everything is out, giving up on a hard error: there's
+// nobody left to report it to
+inline void write_all(int fd, std::string_view data) noexcept {
+    while (!data.empty()) {
+        auto n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data.remove_prefix(static_cast<std::size_t>(n));
+    }
+}
+
+// The write side of sinks that render records into a buffer and write it
+// out elsewhere. Records are rendered on the calling thread before the
+// buffer is claimed, which then only covers copying them into it. One at
+// flush_level or more severe calls flush(), and a buffer that reached size
+// bytes calls buffer_full(). A batch is rendered whole and claims the buffer
+// once.
+//
+// The buffer is guarded by an atomic flag rather than a mutex, so that
+// emergency_flush can try to claim it from a signal handler. If any thread
+// holds the flag right then, the one the signal interrupted included, the
+// handler leaves everything buffered behind, with the records being
+// appended.
+class BufferingSink : public Sink {
+  public:
+    void write(const Record& rec) override { append({ &rec, 1 }); }
+
+    void write_batch(std::span<const Record> recs) override { append(recs); }
+
+  protected:
+    BufferingSink(std::size_t size, LogLevel flush_level) :
+        _size(size), _flush_level(flush_level) {}
+
+    // called without the flag, by the thread whose record filled the buffer
+    virtual void buffer_full() = 0;
+
+    // held for a copy at a time, so waiters only yield
+    void claim_buffer() noexcept {
+        while (_claimed.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // async-signal-safe
+    bool try_claim_buffer() noexcept {
+        return !_claimed.exchange(true, std::memory_order_acquire);
+    }
+
+    void release_buffer() noexcept {
+        _buffered.store(_active.size(), std::memory_order_relaxed);
+        _claimed.store(false, std::memory_order_release);
+    }
+
+    // swaps the buffer for the empty out, false if there was nothing in it
+    bool take(std::string& out) noexcept {
+        claim_buffer();
+        bool any = !_active.empty();
+        if (any) _active.swap(out);
+        release_buffer();
+        return any;
+    }
+
+    // size of _active, for a look without claiming it
+    std::size_t buffered() const noexcept {
+        return _buffered.load(std::memory_order_relaxed);
+    }
+
+    std::string _active;    // claim_buffer() held
+    bool _colors { false }; // set once, while constructing
+
+  private:
+    void append(std::span<const Record> recs) {
+        thread_local std::string lines;
+        lines.clear();
+        bool urgent = false;
+        for (const auto& rec : recs) {
+            render_default(rec, lines, _colors);
+            urgent |= rec.level() <= _flush_level;
+        }
+        claim_buffer();
+        try {
+            _active.append(lines);
+        } catch (...) {
+            release_buffer();
+            throw;
+        }
+        bool full = _active.size() >= _size;
+        release_buffer();
+        if (urgent) {
+            flush();
+        } else if (full) {
+            buffer_full();
+        }
+    }
+
+    std::size_t _size;
+    LogLevel _flush_level;
+    std::atomic<bool> _claimed { false };
+    std::atomic<std::size_t> _buffered { 0 };
+};
+
+} // namespace internal
+
+// Renders records into a buffer that goes out with a single write(2) per
+// flush. Records are rendered before the buffer's lock is taken; the write
+// happens on a second buffer so other threads keep appending meanwhile. A
+// thread that fills the buffer while another one is writing doesn't wait
+// for it, the buffer just grows past the threshold until the next flush.
+class BufferedSink : public internal::BufferingSink {
+  public:
+    explicit BufferedSink(int fd, BufferOptions opts = {}) :
+        BufferingSink(opts.size, opts.flush_level),
+        _fd(fd),
+        _owns_fd(false),
+        _opts(opts) {
+        start();
+    }
+
+    // appends to path, creating it if needed
+    explicit BufferedSink(const char* path, BufferOptions opts = {}) :
+        BufferingSink(opts.size, opts.flush_level),
+        _fd(::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)),
+        _owns_fd(true),
+        _opts(opts) {
+        if (_fd < 0) { throw std::runtime_error("Failed to open log file"); }
+        start();
+    }
+
+    ~BufferedSink() override {
+        if (_timer.joinable()) {
+            _timer.request_stop();
+            _timer.join();
+        }
+        flush();
+        if (_owns_fd) ::close(_fd);
+    }
+
+    BufferedSink(const BufferedSink&)            = delete;
+    BufferedSink& operator=(const BufferedSink&) = delete;
+
+    void flush() override {
+        std::lock_guard io(_io_mutex);
+        flush_locked();
+    }
+
+    // Writes the buffer being filled, unless a thread holds it, then those
+    // records are lost (see BufferingSink). Whatever the flushing thread is
+    // writing keeps going on that thread.
+    void emergency_flush() noexcept override {
+        if (!try_claim_buffer()) return;
+        internal::write_all(_fd, _active);
+        _active.clear();
+        release_buffer();
+    }
+
+    int fd() const noexcept { return _fd; }
+
+  private:
+    void start() {
+        _colors = internal::use_colors(_opts.colors, _fd);
+        _active.reserve(_opts.size + _opts.size / 4);
+        _spare.reserve(_opts.size + _opts.size / 4);
+        if (_opts.interval.count() <= 0) return;
+        _timer = std::jthread([this](std::stop_token stop) {
+            std::unique_lock lock(_timer_mutex);
+            while (!stop.stop_requested()) {
+                _timer_cv.wait_for(
+                        lock, stop, _opts.interval, [] { return false; });
+                if (!stop.stop_requested()) flush();
+            }
+        });
+    }
+
+    // a thread that finds another one writing leaves the buffer to it
+    void buffer_full() override {
+        std::unique_lock io(_io_mutex, std::try_to_lock);
+        if (io) flush_locked();
+    }
+
+    // _io_mutex held
+    void flush_locked() noexcept {
+        if (!take(_spare)) return;
+        internal::write_all(_fd, _spare);
+        _spare.clear();
+    }
+
+    int _fd;
+    bool _owns_fd;
+    BufferOptions _opts;
+    std::mutex _io_mutex; // guards _spare and the fd
+    std::string _spare;
+    std::mutex _timer_mutex;
+    std::condition_variable_any _timer_cv;
+    std::jthread _timer;
+};
+
+} // namespace tmb
+
+#endif // TMB_CPP_SINKS_BUFFERED_SINK_HPP_
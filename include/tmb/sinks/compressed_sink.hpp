@@ -0,0 +1,395 @@
+#ifndef TMB_CPP_SINKS_COMPRESSED_SINK_HPP_
+#define TMB_CPP_SINKS_COMPRESSED_SINK_HPP_
+
+#include <tmb/sinks/buffered_sink.hpp>
+#include <tmb/tmb.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// The codecs are optional. Each is compiled in when its header is found,
+// unless TMB_HAS_ZSTD / TMB_HAS_LZ4 say otherwise; the CMake target sets
+// them from the TMB_WITH_ZSTD and TMB_WITH_LZ4 options, which link the
+// libraries.
+#ifndef TMB_HAS_ZSTD
+    #if __has_include(<zstd.h>)
+        #define TMB_HAS_ZSTD 1
+    #else
+        #define TMB_HAS_ZSTD 0
+    #endif
+#endif
+
+#ifndef TMB_HAS_LZ4
+    #if __has_include(<lz4frame.h>)
+        #define TMB_HAS_LZ4 1
+    #else
+        #define TMB_HAS_LZ4 0
+    #endif
+#endif
+
+#if TMB_HAS_ZSTD
+    #include <zstd.h>
+#endif
+#if TMB_HAS_LZ4
+    #include <lz4frame.h>
+#endif
+
+namespace tmb {
+
+enum class Compression {
+    Zstd, // .zst
+    Lz4,  // .lz4
+};
+
+struct CompressedOptions {
+    Compression codec = Compression::Zstd;
+    // the codec's compression level, zero for its default
+    int level = 0;
+    // uncompressed bytes per frame
+    std::size_t frame_size = 1024 * 1024;
+    // close the current frame at least this often, zero leaves it to
+    // frame_size, flush_level and flush()
+    std::chrono::milliseconds interval { 1000 };
+    // records at this level or more severe close the frame right away
+    LogLevel flush_level = LogLevel::Error;
+    // move to the next file once this many compressed bytes went into one,
+    // zero keeps writing to the first
+    std::size_t rotate_size = 0;
+};
+
+// whether the codec was compiled in
+constexpr bool compression_available(Compression codec) noexcept {
+    return codec == Compression::Zstd ? TMB_HAS_ZSTD : TMB_HAS_LZ4;
+}
+
+namespace internal {
+
+// Compresses a buffer into one complete frame, reusing the codec's context
+class FrameEncoder {
+  public:
+    FrameEncoder(Compression codec, int level) : _codec(codec), _level(level) {
+        if (!compression_available(codec)) {
+            throw std::invalid_argument("Compression codec not available");
+        }
+#if TMB_HAS_ZSTD
+        if (codec == Compression::Zstd) {
+            _zstd = ZSTD_createCCtx();
+            if (!_zstd) throw std::bad_alloc();
+        }
+#endif
+    }
+
+    ~FrameEncoder() {
+#if TMB_HAS_ZSTD
+        ZSTD_freeCCtx(_zstd);
+#endif
+    }
+
+    FrameEncoder(const FrameEncoder&)            = delete;
+    FrameEncoder& operator=(const FrameEncoder&) = delete;
+
+    // false when the codec failed, out is left empty then
+    bool encode([[maybe_unused]] std::string_view in, std::string& out) {
+        out.clear();
+#if TMB_HAS_ZSTD
+        if (_codec == Compression::Zstd) {
+            out.resize(ZSTD_compressBound(in.size()));
+            auto n = ZSTD_compressCCtx(_zstd,
+                                       out.data(),
+                                       out.size(),
+                                       in.data(),
+                                       in.size(),
+                                       _level);
+            if (ZSTD_isError(n)) n = 0;
+            out.resize(n);
+            return n != 0;
+        }
+#endif
+#if TMB_HAS_LZ4
+        if (_codec == Compression::Lz4) {
+            LZ4F_preferences_t prefs {};
+            prefs.frameInfo.blockSizeID = LZ4F_max256KB;
+            prefs.frameInfo.blockMode   = LZ4F_blockIndependent;
+            prefs.compressionLevel      = _level;
+            out.resize(LZ4F_compressFrameBound(in.size(), &prefs));
+            auto n = LZ4F_compressFrame(
+                    out.data(), out.size(), in.data(), in.size(), &prefs);
+            if (LZ4F_isError(n)) n = 0;
+            out.resize(n);
+            return n != 0;
+        }
+#endif
+        return false;
+    }
+
+  private:
+    Compression _codec;
+    [[maybe_unused]] int _level;
+#if TMB_HAS_ZSTD
+    ZSTD_CCtx* _zstd = nullptr;
+#endif
+};
+
+// writev(2) until everything is out, picking up after short writes
+inline void writev_all(int fd, iovec* iov, int count) noexcept {
+    while (count > 0) {
+        auto n = ::writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        auto done = static_cast<std::size_t>(n);
+        while (count > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+}
+
+// Writes data as valid frames of raw (stored) blocks, without the codec: no
+// allocation, one writev(2) per frame, for emergency_flush. A frame holds up
+// to 32 blocks, 4MB with zstd and 2MB with lz4.
+inline void write_stored_frame(int fd,
+                               Compression codec,
+                               std::string_view data) noexcept {
+    constexpr std::size_t max_blocks = 32;
+    // zstd: magic, no checksum or content size, 128KB window (= max block)
+    static constexpr unsigned char zstd_frame[] = { 0x28, 0xb5, 0x2f,
+                                                    0xfd, 0x00, 0x38 };
+    // lz4: magic, independent 64KB blocks, no checksums; 0x82 is the
+    // header checksum of that descriptor
+    static constexpr unsigned char lz4_frame[] = { 0x04, 0x22, 0x4d, 0x18,
+                                                   0x60, 0x40, 0x82 };
+    static constexpr unsigned char lz4_end[4]  = {};
+    bool zstd         = codec == Compression::Zstd;
+    std::size_t block = zstd ? 128 * 1024 : 64 * 1024;
+    auto piece        = [](const void* p, std::size_t n) {
+        return iovec { const_cast<void*>(p), n };
+    };
+    while (!data.empty()) {
+        iovec iov[2 * max_blocks + 2];
+        unsigned char headers[max_blocks][4];
+        int count = 0;
+        if (zstd) {
+            iov[count++] = piece(zstd_frame, sizeof zstd_frame);
+        } else {
+            iov[count++] = piece(lz4_frame, sizeof lz4_frame);
+        }
+        for (std::size_t i = 0; i < max_blocks && !data.empty(); ++i) {
+            auto n       = data.size() < block ? data.size() : block;
+            auto* header = headers[i];
+            std::uint32_t v;
+            int bytes;
+            if (zstd) {
+                bool last = n == data.size() || i + 1 == max_blocks;
+                v         = static_cast<std::uint32_t>(n << 3 | (last ? 1 : 0));
+                bytes     = 3;
+            } else {
+                v     = static_cast<std::uint32_t>(n) | 0x80000000u;
+                bytes = 4;
+            }
+            for (int b = 0; b < bytes; ++b) {
+                header[b] = static_cast<unsigned char>(v >> (8 * b));
+            }
+            iov[count++] = piece(header, static_cast<std::size_t>(bytes));
+            iov[count++] = piece(data.data(), n);
+            data.remove_prefix(n);
+        }
+        if (!zstd) iov[count++] = piece(lz4_end, sizeof lz4_end);
+        writev_all(fd, iov, count);
+    }
+}
+
+} // namespace internal
+
+// Writes records compressed, to path.0.zst, path.1.zst... (or .lz4;
+// numbering continues after the existing files). Records are rendered into
+// a buffer, a background thread compresses it into a frame of its own once
+// it holds frame_size bytes, after interval, on a record at flush_level and
+// on flush(). Every frame decodes independently, so a file stays readable
+// (zstdcat, lz4cat; tail-able a frame at a time) up to its last complete
+// frame, also after a crash.
+//
+// Compiled in only for the codecs whose headers are found, the constructor
+// throws std::invalid_argument for the others.
+class CompressedSink : public internal::BufferingSink {
+  public:
+    explicit CompressedSink(std::string path, CompressedOptions opts = {}) :
+        BufferingSink(opts.frame_size, opts.flush_level),
+        _path(std::move(path)),
+        _opts(opts),
+        _encoder(opts.codec, opts.level) {
+        if (_opts.frame_size == 0) {
+            throw std::invalid_argument("frame_size must not be zero");
+        }
+        struct stat st;
+        while (::stat(file_path(_index).c_str(), &st) == 0) ++_index;
+        _fd = open_file(_index);
+        if (_fd < 0) throw std::runtime_error("Failed to open log file");
+        _active.reserve(_opts.frame_size + _opts.frame_size / 4);
+        _worker = std::jthread([this](std::stop_token stop) { run(stop); });
+    }
+
+    ~CompressedSink() override {
+        _worker.request_stop();
+        _worker.join();
+        // whatever came in after the worker's last frame
+        if (take(_sealing)) write_frame(_sealing);
+        claim_io();
+        ::close(_fd);
+        _fd = -1;
+        release_io();
+    }
+
+    CompressedSink(const CompressedSink&)            = delete;
+    CompressedSink& operator=(const CompressedSink&) = delete;
+
+    // returns once what was written before the call is on disk as a frame
+    void flush() override {
+        std::unique_lock lock(_mutex);
+        auto target = ++_requested;
+        _cv.notify_one();
+        _done_cv.wait(lock, [&] { return _sealed >= target; });
+    }
+
+    // Writes the buffered records as frames of uncompressed blocks, unless
+    // a thread holds the buffer (see BufferingSink) or the worker is writing
+    // to the file (or rotating it), then those records are lost. Either way
+    // the file only ever gets whole frames.
+    void emergency_flush() noexcept override {
+        if (!try_claim_buffer()) return;
+        if (!_io.exchange(true, std::memory_order_acquire)) {
+            internal::write_stored_frame(_fd, _opts.codec, _active);
+            _active.clear();
+            release_io();
+        }
+        release_buffer();
+    }
+
+    // path of the file currently written to
+    std::string current_path() const {
+        return file_path(_index.load(std::memory_order_relaxed));
+    }
+
+  private:
+    std::string file_path(unsigned index) const {
+        return _path + "." + std::to_string(index) +
+               (_opts.codec == Compression::Zstd ? ".zst" : ".lz4");
+    }
+
+    int open_file(unsigned index) const {
+        return ::open(file_path(index).c_str(),
+                      O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                      0644);
+    }
+
+    // the worker checks buffered() holding _mutex, taking it here means it
+    // is either still to check or already waiting
+    void buffer_full() override {
+        { std::lock_guard lock(_mutex); }
+        _cv.notify_one();
+    }
+
+    void run(std::stop_token stop) {
+        std::unique_lock lock(_mutex);
+        for (;;) {
+            auto due = [&] {
+                return _requested != _sealed ||
+                       buffered() >= _opts.frame_size;
+            };
+            if (_opts.interval.count() > 0) {
+                _cv.wait_for(lock, stop, _opts.interval, due);
+            } else {
+                _cv.wait(lock, stop, due);
+            }
+            if (stop.stop_requested()) return;
+            auto target = _requested;
+            lock.unlock();
+            if (take(_sealing)) {
+                write_frame(_sealing);
+                _sealing.clear();
+            }
+            lock.lock();
+            _sealed = target;
+            _done_cv.notify_all();
+        }
+    }
+
+    // worker thread, or the destructor once it's gone
+    void write_frame(std::string_view data) noexcept {
+        if (data.empty()) return;
+        try {
+            if (!_encoder.encode(data, _frame)) return;
+        } catch (...) {
+            return;
+        }
+        claim_io();
+        internal::write_all(_fd, _frame);
+        _file_bytes += _frame.size();
+        if (_opts.rotate_size && _file_bytes >= _opts.rotate_size) rotate();
+        release_io();
+    }
+
+    // an emergency_flush holding the file is done after one writev(2)
+    void claim_io() noexcept {
+        while (_io.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void release_io() noexcept { _io.store(false, std::memory_order_release); }
+
+    // _io held. Keeps the current file if the next one can't be opened.
+    void rotate() noexcept {
+        auto index = _index.load(std::memory_order_relaxed) + 1;
+        int fd     = -1;
+        try {
+            fd = open_file(index);
+        } catch (...) {
+        }
+        if (fd < 0) return;
+        ::close(_fd);
+        _fd = fd;
+        _index.store(index, std::memory_order_relaxed);
+        _file_bytes = 0;
+    }
+
+    std::string _path;
+    CompressedOptions _opts;
+    internal::FrameEncoder _encoder; // worker only
+    std::atomic<unsigned> _index { 0 };
+    // whoever writes to the file (the worker, or emergency_flush) holds it
+    std::atomic<bool> _io { false };
+    int _fd { -1 };                // _io held, or while constructing
+    std::size_t _file_bytes { 0 }; // worker only
+    std::string _sealing;          // worker only
+    std::string _frame;            // worker only
+    std::mutex _mutex; // guards the counters below, for the waits on them
+    std::uint64_t _requested { 0 }; // flushes asked for
+    std::uint64_t _sealed { 0 };    // flushes done
+    std::condition_variable_any _cv;
+    std::condition_variable_any _done_cv;
+    std::jthread _worker;
+};
+
+} // namespace tmb
+
+#endif // TMB_CPP_SINKS_COMPRESSED_SINK_HPP_
@@ -0,0 +1,246 @@
+#ifndef TMB_CPP_SINKS_MMAP_SINK_HPP_
+#define TMB_CPP_SINKS_MMAP_SINK_HPP_
+
+#include <tmb/tmb.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tmb {
+
+enum class MsyncPolicy {
+    // the kernel writes dirty pages back on its own schedule, also when the
+    // process crashed
+    Never,
+    // msync(MS_ASYNC) a segment when it's rotated out
+    OnRotate,
+    // additionally msync(MS_SYNC) in flush(), which records at flush_level
+    // or more severe trigger
+    OnFlush,
+};
+
+struct MmapOptions {
+    // size of each preallocated segment file
+    std::size_t segment_size = 64 * 1024 * 1024;
+    // start a new segment at least this often, zero rotates by size only
+    std::chrono::seconds rotate_interval { 0 };
+    MsyncPolicy msync    = MsyncPolicy::Never;
+    LogLevel flush_level = LogLevel::Error;
+    // madvise(MADV_SEQUENTIAL), pages behind the write position can go first
+    bool sequential = true;
+    // fault the whole segment in when it's mapped instead of on first write
+    bool prefault = false;
+};
+
+// Writes records into memory mapped segment files path.0, path.1, ...
+// (numbering continues after the existing ones). A record costs a render
+// and a memcpy, there's no syscall per record, and the pages reach the file
+// even if the process dies. A segment is truncated to the bytes actually
+// written when it's rotated out or the sink is destroyed; after a crash the
+// last segment keeps its zero filled tail.
+//
+// A segment's blocks are allocated before it's mapped. When that fails (a
+// full disk) records are dropped and the next segment is tried again a
+// second later.
+class MmapSink : public Sink {
+  public:
+    explicit MmapSink(std::string path, MmapOptions opts = {}) :
+        _path(std::move(path)), _opts(opts) {
+        if (_opts.segment_size == 0) {
+            throw std::invalid_argument("segment_size must not be zero");
+        }
+        struct stat st;
+        while (::stat(segment_path(_index).c_str(), &st) == 0) ++_index;
+        if (!open_segment(_index)) {
+            throw std::runtime_error("Failed to map log segment");
+        }
+    }
+
+    ~MmapSink() override { close_segment(); }
+
+    MmapSink(const MmapSink&)            = delete;
+    MmapSink& operator=(const MmapSink&) = delete;
+
+    void write(const Record& rec) override {
+        thread_local std::string line;
+        line.clear();
+        internal::render_default(rec, line);
+        if (line.size() > _opts.segment_size) {
+            line.resize(_opts.segment_size);
+        }
+
+        for (;;) {
+            std::uint64_t seen;
+            {
+                std::shared_lock lock(_map_mutex);
+                seen = _generation;
+                if (_base && !rotation_due(rec)) {
+                    auto at = _offset.fetch_add(line.size(),
+                                                std::memory_order_relaxed);
+                    if (at + line.size() <= _opts.segment_size) {
+                        std::memcpy(_base + at, line.data(), line.size());
+                        break;
+                    }
+                    // reservations only grow, so the first one that didn't
+                    // fit marks the end of the data
+                    auto end = _end.load(std::memory_order_relaxed);
+                    while (at < end &&
+                           !_end.compare_exchange_weak(
+                                   end, at, std::memory_order_relaxed)) {
+                    }
+                }
+            }
+            if (!rotate(seen)) return;
+        }
+        if (_opts.msync == MsyncPolicy::OnFlush &&
+            rec.level() <= _opts.flush_level) {
+            flush();
+        }
+    }
+
+    void flush() override {
+        if (_opts.msync != MsyncPolicy::OnFlush) return;
+        std::shared_lock lock(_map_mutex);
+        if (_base) ::msync(_base, used(), MS_SYNC);
+    }
+
+    // path of the segment currently written to
+    std::string current_path() const {
+        std::shared_lock lock(_map_mutex);
+        return segment_path(_index);
+    }
+
+  private:
+    std::string segment_path(unsigned index) const {
+        return _path + "." + std::to_string(index);
+    }
+
+    std::size_t used() const noexcept {
+        auto n = std::min(_offset.load(std::memory_order_relaxed),
+                          _end.load(std::memory_order_relaxed));
+        return std::min(n, _opts.segment_size);
+    }
+
+    bool rotation_due(const Record& rec) const noexcept {
+        if (_opts.rotate_interval.count() <= 0) return false;
+        return rec.ctx.ts_sec >= _deadline.load(std::memory_order_relaxed);
+    }
+
+    static std::int64_t steady_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+    }
+
+    // after a segment failed to open, until the retry is due
+    bool backing_off() const noexcept {
+        return steady_ns() < _retry_ns.load(std::memory_order_relaxed);
+    }
+
+    // Moves to the next segment unless another writer already did while we
+    // waited for the lock. false when no segment could be mapped, the record
+    // is dropped then, and so are the ones until the retry is due.
+    bool rotate(std::uint64_t seen) {
+        if (backing_off()) return false;
+        std::unique_lock lock(_map_mutex);
+        if (_generation != seen) return true;
+        if (backing_off()) return false;
+        close_segment();
+        if (open_segment(_index + 1)) return true;
+        // try again in a second
+        _retry_ns.store(steady_ns() + 1'000'000'000, std::memory_order_relaxed);
+        return false;
+    }
+
+    // _map_mutex held exclusively, or during construction. A failed segment's
+    // file is removed and index stays free for the next attempt.
+    bool open_segment(unsigned index) {
+        auto path = segment_path(index);
+        int fd    = ::open(
+                path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        // never map blocks that aren't there: the first write to a page the
+        // file system can't back raises SIGBUS
+        auto size  = static_cast<off_t>(_opts.segment_size);
+        void* base = MAP_FAILED;
+        if (::posix_fallocate(fd, 0, size) == 0) {
+            int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+            if (_opts.prefault) flags |= MAP_POPULATE;
+#endif
+            base = ::mmap(nullptr,
+                          _opts.segment_size,
+                          PROT_READ | PROT_WRITE,
+                          flags,
+                          fd,
+                          0);
+        }
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            ::unlink(path.c_str());
+            return false;
+        }
+        _fd    = fd;
+        _index = index;
+        _base  = static_cast<char*>(base);
+        if (_opts.sequential) {
+            ::madvise(_base, _opts.segment_size, MADV_SEQUENTIAL);
+        }
+        if (_opts.prefault) {
+            ::madvise(_base, _opts.segment_size, MADV_WILLNEED);
+        }
+        _offset.store(0, std::memory_order_relaxed);
+        _end.store(SIZE_MAX, std::memory_order_relaxed);
+        if (_opts.rotate_interval.count() > 0) {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            auto sec = std::chrono::duration_cast<std::chrono::seconds>(now);
+            _deadline.store((sec + _opts.rotate_interval).count(),
+                            std::memory_order_relaxed);
+        }
+        ++_generation;
+        return true;
+    }
+
+    // _map_mutex held exclusively, or during destruction
+    void close_segment() noexcept {
+        if (!_base) return;
+        auto n = used();
+        if (_opts.msync != MsyncPolicy::Never) ::msync(_base, n, MS_ASYNC);
+        ::munmap(_base, _opts.segment_size);
+        _base = nullptr;
+        if (::ftruncate(_fd, static_cast<off_t>(n)) != 0) {
+            // keeps the zero filled tail, readers skip it
+        }
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    std::string _path;
+    MmapOptions _opts;
+    unsigned _index { 0 };
+    int _fd { -1 };
+    char* _base { nullptr };
+    // writers hold it shared while copying, rotation holds it exclusively
+    mutable std::shared_mutex _map_mutex;
+    std::uint64_t _generation { 0 }; // bumped per segment, under _map_mutex
+    alignas(internal::cache_line_size) std::atomic<std::size_t> _offset { 0 };
+    std::atomic<std::size_t> _end { SIZE_MAX };
+    std::atomic<std::int64_t> _deadline { 0 };
+    std::atomic<std::int64_t> _retry_ns { 0 }; // steady clock
+};
+
+} // namespace tmb
+
+#endif // TMB_CPP_SINKS_MMAP_SINK_HPP_
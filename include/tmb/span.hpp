@@ -0,0 +1,98 @@
+#ifndef TMB_CPP_SPAN_HPP_
+#define TMB_CPP_SPAN_HPP_
+
+#include <tmb/tmb.hpp>
+
+#include <chrono>
+#include <source_location>
+#include <string_view>
+
+namespace tmb {
+
+// Logs how long a scope took when it ends:
+//
+//   {
+//       tmb::Span span(lgr, "rebalance", std::chrono::milliseconds(5));
+//       ...
+//   } // "rebalance took 7.214ms", only if it took 5ms or more
+//
+// The elapsed time also goes into the record's stopwatch fields. A span
+// under its threshold costs two steady_clock reads and a compare, one at a
+// disabled level doesn't read the clock at all. name must outlive the span.
+class Span {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    Span(Logger& logger,
+         std::string_view name,
+         std::chrono::nanoseconds threshold = {},
+         LogLevel level                     = LogLevel::Info,
+         const std::source_location& loc = std::source_location::current()) :
+        Span(&logger, name, threshold, level, loc) {}
+
+    // on the default logger
+    explicit Span(
+            std::string_view name,
+            std::chrono::nanoseconds threshold = {},
+            LogLevel level                     = LogLevel::Info,
+            const std::source_location& loc = std::source_location::current()) :
+        Span(nullptr, name, threshold, level, loc) {}
+
+    ~Span() {
+        if (!_active) return;
+        auto took = elapsed();
+        if (took < _threshold) return;
+        // the location is only taken apart for spans that get logged
+        internal::SourceMeta meta(_loc);
+        try {
+            if (_logger) {
+                _logger->log_elapsed(_level, meta, _name, took);
+            } else {
+                internal::log_default_elapsed(_level, meta, _name, took);
+            }
+        } catch (...) {
+        }
+    }
+
+    Span(const Span&)            = delete;
+    Span& operator=(const Span&) = delete;
+
+    // the time since the span started, zero if its level is disabled
+    std::chrono::nanoseconds elapsed() const noexcept {
+        if (!_active) return {};
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - _start);
+    }
+
+    // ends the span without logging it
+    void cancel() noexcept { _active = false; }
+
+  private:
+    Span(Logger* logger,
+         std::string_view name,
+         std::chrono::nanoseconds threshold,
+         LogLevel level,
+         const std::source_location& loc) :
+        _logger(logger),
+        _name(name),
+        _threshold(threshold),
+        _level(level),
+        _loc(loc),
+        _active(internal::level_active(level) &&
+                (logger ? logger->should_log(level)
+                        : internal::default_logger_enabled(level))) {
+        if (_active) _start = clock::now();
+    }
+
+    Logger* _logger;
+    std::string_view _name;
+    std::chrono::nanoseconds _threshold;
+    LogLevel _level;
+    std::source_location _loc;
+    bool _active;
+    clock::time_point _start {};
+};
+
+} // namespace tmb
+
+#endif // TMB_CPP_SPAN_HPP_
@@ -1,13 +1,45 @@
 #ifndef TMB_CPP_HPP_
 #define TMB_CPP_HPP_
 
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <source_location>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <atomic> // very very important to include it BEFORE tmb.h :)
 
+#include <tmb/fwd.hpp>
+#include <tmb/internal/binary_format.hpp>
+#include <tmb/internal/bounded_queue.hpp>
+#include <tmb/internal/chunk_pool.hpp>
+#include <tmb/internal/clock.hpp>
+#include <tmb/internal/emergency.hpp>
+#include <tmb/internal/fields.hpp>
+#include <tmb/internal/layout.hpp>
+#include <tmb/internal/rate_limit.hpp>
+#include <tmb/internal/stats.hpp>
+#include <tmb/internal/thread_context.hpp>
+
 namespace tmb {
 
 namespace c {
@@ -28,6 +60,91 @@ enum class LogLevel : int {
     All     = TMB_LEVEL_ALL
 };
 
+// Calls above this level are compiled out of the level functions
+// (tmb::debug, Logger::trace, ...). Their arguments are still evaluated, so
+// keep side effects out of log statements meant to be stripped.
+#ifndef TMB_ACTIVE_LEVEL
+    #define TMB_ACTIVE_LEVEL TMB_LEVEL_ALL
+#endif
+
+// Count the calls the runtime level check stops (LevelCounts::filtered).
+// Off by default: it puts a write on the path a disabled call takes.
+#ifndef TMB_COUNT_FILTERED
+    #define TMB_COUNT_FILTERED 0
+#endif
+
+// Capacity reserved for each thread's message buffer, longer messages grow it
+#ifndef TMB_MESSAGE_BUFFER_SIZE
+    #define TMB_MESSAGE_BUFFER_SIZE 1024
+#endif
+
+// The logging core (formatting from std::format_args, the stats, the hand
+// over to timber-c, sinks and the async queue) is inline by default. With
+// TMB_COMPILED_LIB it's compiled once, into the timber-cpp-compiled library,
+// and call sites only capture their arguments. src/tmb.cpp is that library.
+#ifdef TMB_COMPILED_LIB
+    #define _tmb_ccp_CORE__
+    #ifdef TMB_CORE_SOURCE
+        #define _tmb_ccp_CORE_DEFS__ 1
+    #else
+        #define _tmb_ccp_CORE_DEFS__ 0
+    #endif
+#else
+    #define _tmb_ccp_CORE__ inline
+    #define _tmb_ccp_CORE_DEFS__ 1
+#endif
+
+// What an async logger does when its queue is full
+enum class OverflowPolicy {
+    Block,      // wait for the writer thread to make room (what the
+                // writer thread logs itself is dropped instead)
+    DropNewest, // discard the record being logged
+    DropOldest  // discard the oldest queued record
+};
+
+struct AsyncOptions {
+    // Records, rounded up to a power of two. A queued record takes 448
+    // bytes, allocated and touched when the logger is made: 3.5MB for the
+    // default.
+    std::size_t capacity    = 8192;
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    // copy the arguments into the queue and format on the writer thread,
+    // see is_deferrable
+    bool deferred = false;
+    // Give every logging thread its own queue of lane_capacity records,
+    // drained round-robin by the writer. With the logger's counters kept
+    // per thread too, producers then never write to a cache line another
+    // producer writes to, short of counting drops when a queue overflows.
+    // That is what lets many threads share one logger. Records from
+    // different threads may come out in a different order than they were
+    // logged. Past 128 threads new threads share the existing queues. The
+    // queue of capacity records stays, for threads whose own queue couldn't
+    // be allocated.
+    bool per_thread = false;
+    // Records per thread with per_thread, rounded up to a power of two. Each
+    // thread's queue is allocated and touched on its first record, at 448
+    // bytes a record: 448KB per logging thread for the default, 56MB for
+    // the full 128.
+    std::size_t lane_capacity = 1024;
+    // Messages too long for a queue cell (256 bytes) are stored in a
+    // preallocated arena of 248 byte chunks. Every queue has an arena of its
+    // own, so a per_thread producer shares its free list with the writer
+    // only: arena_chunks for the shared queue, lane_arena_chunks for each
+    // thread's. A chunk takes 256 bytes, allocated with its queue, 32KB per
+    // thread for the default. Once a queue's arena is exhausted, or with
+    // zero, messages are copied to the heap instead.
+    std::size_t arena_chunks      = 1024;
+    std::size_t lane_arena_chunks = 128;
+};
+
+// Whether an argument can be copied into the async queue as raw bytes and
+// formatted later on the writer thread. Strings are always copied eagerly,
+// other types fall back to formatting on the calling thread. Specialize this
+// for trivially copyable types that own everything they print.
+template <typename T>
+struct is_deferrable : std::bool_constant<std::is_arithmetic_v<T> ||
+                                          std::is_enum_v<T>> {};
+
 inline void print_version() {
     c::tmb_print_version();
 }
@@ -37,139 +154,1742 @@ inline const char* get_version() {
 
 namespace internal {
 
-class LogContext {
+constexpr bool level_enabled(LogLevel level, int threshold) noexcept {
+    return static_cast<int>(level) <= threshold;
+}
+
+constexpr bool level_active(LogLevel level) noexcept {
+    return level_enabled(level, TMB_ACTIVE_LEVEL);
+}
+
+// The default logger's level, Debug like a Logger's. It's the only filter
+// tmb::info and friends go through: their timber-c logger is made with
+// everything enabled (see default_c_logger), so a call this stops is never
+// formatted and one it lets through is never dropped afterwards.
+inline std::atomic<int>& default_logger_level() noexcept {
+    static std::atomic<int> level { static_cast<int>(LogLevel::Debug) };
+    return level;
+}
+
+struct ThreadBuffer {
+    std::string str;
+    bool in_use { false };
+
+    ThreadBuffer() { str.reserve(TMB_MESSAGE_BUFFER_SIZE); }
+};
+
+inline ThreadBuffer& thread_buffer() {
+    thread_local ThreadBuffer buffer;
+    return buffer;
+}
+
+// Borrows the calling thread's message buffer for one log call. A log call
+// made while formatting another one (from inside a formatter) gets a buffer
+// of its own instead of clobbering the outer message.
+class MessageBuffer {
   public:
-    LogContext(
-            LogLevel level,
-            const std::source_location& loc = std::source_location::current()) :
-        level_(level), location_(loc) {}
+    MessageBuffer() : _thread(thread_buffer()), _nested(_thread.in_use) {
+        _thread.in_use = true;
+        str().clear();
+    }
 
-    c::tmb_log_ctx_t to_c() const noexcept {
-        auto filename     = location_.file_name();
-        auto funcname     = location_.function_name();
-        auto filename_len = std::strlen(filename);
-        auto funcname_len = std::strlen(funcname);
+    ~MessageBuffer() {
+        if (_nested) return;
+        _thread.in_use = false;
+        // don't let one huge message pin its memory for the thread's lifetime
+        if (_thread.str.capacity() > 64 * TMB_MESSAGE_BUFFER_SIZE) {
+            _thread.str = std::string();
+            _thread.str.reserve(TMB_MESSAGE_BUFFER_SIZE);
+        }
+    }
+
+    MessageBuffer(const MessageBuffer&)            = delete;
+    MessageBuffer& operator=(const MessageBuffer&) = delete;
+
+    std::string& str() noexcept { return _nested ? _own : _thread.str; }
+
+    // set when formatting failed and the buffer holds the error instead
+    bool failed() const noexcept { return _failed; }
+    void set_failed() noexcept { _failed = true; }
 
-        const char* base = filename;
-        for (const char* p = filename; *p; ++p) {
-            if (*p == '/' || *p == '\\') { base = p + 1; }
+  private:
+    ThreadBuffer& _thread;
+    bool _nested;
+    bool _failed { false };
+    std::string _own;
+};
+
+// Formats straight into buf, a failed format turns the record into an error
+// describing it
+_tmb_ccp_CORE__ std::string_view vformat_message(MessageBuffer& buf,
+                                                 LogLevel& level,
+                                                 std::string_view fmt,
+                                                 std::format_args args);
+
+template <typename... Args>
+inline std::string_view format_message(MessageBuffer& buf,
+                                       LogLevel& level,
+                                       std::string_view fmt,
+                                       Args&... args) {
+    return vformat_message(buf, level, fmt, std::make_format_args(args...));
+}
+
+// Same, with trailing tmb::kv fields and the thread's tmb::context fields
+// rendered after the message
+template <typename... Args>
+inline std::string_view format_message(MessageBuffer& buf,
+                                       LogLevel& level,
+                                       FieldStyle style,
+                                       std::string_view fmt,
+                                       Args&... args) {
+    constexpr auto n = message_arg_count<Args...>;
+    if constexpr (n == sizeof...(Args)) {
+        format_message(buf, level, fmt, args...);
+    } else {
+        auto refs = std::tie(args...);
+        [&]<std::size_t... I, std::size_t... J>(std::index_sequence<I...>,
+                                                 std::index_sequence<J...>) {
+            format_message(buf, level, fmt, std::get<I>(refs)...);
+            render_fields(buf.str(), style, std::get<n + J>(refs)...);
+        }(std::make_index_sequence<n> {},
+          std::make_index_sequence<sizeof...(Args) - n> {});
+    }
+    append_context(buf.str(), style, n != sizeof...(Args));
+    return buf.str();
+}
+
+// Everything timber-c wants to know about a call site. It's computed where
+// the location is captured, for checked format strings that happens in a
+// consteval constructor, so per call it's just a copy.
+struct SourceMeta {
+    const char* filename      = "";
+    const char* filename_base = "";
+    const char* funcname      = "";
+    int filename_len          = 0;
+    int filename_base_len     = 0;
+    int funcname_len          = 0;
+    int line                  = 0;
+    int column                = 0;
+
+    constexpr SourceMeta() noexcept = default;
+
+    constexpr explicit SourceMeta(const std::source_location& loc) noexcept :
+        filename(loc.file_name()),
+        filename_base(filename),
+        funcname(loc.function_name()),
+        filename_len(0),
+        filename_base_len(0),
+        funcname_len(static_cast<int>(
+                std::char_traits<char>::length(loc.function_name()))),
+        line(static_cast<int>(loc.line())),
+        column(static_cast<int>(loc.column())) {
+        const char* p = filename;
+        for (; *p; ++p) {
+            if (*p == '/' || *p == '\\') { filename_base = p + 1; }
         }
-        auto base_len = filename_len - (base - filename);
+        filename_len      = static_cast<int>(p - filename);
+        filename_base_len = static_cast<int>(p - filename_base);
+    }
+};
 
+class LogContext {
+  public:
+    // a zero timestamp leaves it to timber-c to take the time, the
+    // stopwatch is the elapsed time of a Span
+    LogContext(LogLevel level,
+               const SourceMeta& meta,
+               Timestamp ts        = {},
+               Timestamp stopwatch = {}) :
+        level_(level), meta_(meta), ts_(ts), stopwatch_(stopwatch) {}
+
+    c::tmb_log_ctx_t to_c() const noexcept {
         return c::tmb_log_ctx_t {
             .log_level         = static_cast<c::tmb_log_level>(level_),
-            .line_no           = static_cast<int>(location_.line()),
-            .filename          = filename,
-            .filename_len      = static_cast<int>(filename_len),
-            .filename_base     = base,
-            .filename_base_len = static_cast<int>(base_len),
-            .funcname          = funcname,
-            .funcname_len      = static_cast<int>(funcname_len),
+            .line_no           = meta_.line,
+            .filename          = meta_.filename,
+            .filename_len      = meta_.filename_len,
+            .filename_base     = meta_.filename_base,
+            .filename_base_len = meta_.filename_base_len,
+            .funcname          = meta_.funcname,
+            .funcname_len      = meta_.funcname_len,
             .message           = nullptr,
             .message_len       = 0,
-            .ts_sec            = 0,
-            .ts_nsec           = 0,
-            .stopwatch_sec     = 0,
-            .stopwatch_nsec    = 0
+            .ts_sec  = static_cast<decltype(c::tmb_log_ctx_t::ts_sec)>(ts_.sec),
+            .ts_nsec = static_cast<decltype(c::tmb_log_ctx_t::ts_nsec)>(
+                    ts_.nsec),
+            .stopwatch_sec =
+                    static_cast<decltype(c::tmb_log_ctx_t::stopwatch_sec)>(
+                            stopwatch_.sec),
+            .stopwatch_nsec =
+                    static_cast<decltype(c::tmb_log_ctx_t::stopwatch_nsec)>(
+                            stopwatch_.nsec)
         };
     }
 
   private:
     LogLevel level_;
-    std::source_location location_;
+    const SourceMeta& meta_;
+    Timestamp ts_;
+    Timestamp stopwatch_;
 };
 
-inline void log_default_logger_impl(LogLevel level,
-                                    const std::source_location& loc,
-                                    std::string_view msg) {
-    c::tmb_log_default(LogContext(level, loc).to_c(),
-                       "%.*s",
-                       static_cast<int>(msg.size()),
-                       msg.data());
+// The timber-c logger behind the tmb:: free functions. timber-c's own
+// default logger filters with a level of its own that it has no call to
+// change, so this one is made with everything enabled, as Logger does, and
+// default_logger_level decides alone. Never destroyed, records logged from
+// static destructors still have somewhere to go; timber-c's default logger
+// is used if it can't be made.
+inline c::tmb_logger_t* default_c_logger() noexcept {
+    static c::tmb_logger_t* logger = [] {
+        c::tmb_logger_cfg_t cfg {
+            .log_level     = static_cast<c::tmb_log_level>(LogLevel::All),
+            .enable_colors = colors_wanted(STDOUT_FILENO),
+        };
+        auto* created = c::tmb_logger_create("default", cfg);
+        return created ? created : c::tmb_get_default_logger();
+    }();
+    return logger;
+}
+
+// The single point where records cross into timber-c. The message travels
+// pre-formatted in ctx.message; "%.*s" is still passed because tmb_log is
+// the only entry point timber-c exposes for it. A null logger means the
+// default one.
+inline void emit(c::tmb_logger_t* logger,
+                 c::tmb_log_ctx_t ctx,
+                 std::string_view msg) noexcept {
+    ctx.message     = msg.data();
+    ctx.message_len = static_cast<int>(msg.size());
+    if (!logger) logger = default_c_logger();
+    c::tmb_log(ctx, logger, "%.*s", ctx.message_len, ctx.message);
 }
+
+inline std::string_view level_name(LogLevel level) noexcept {
+    switch (level) {
+    case LogLevel::None: return "NONE";
+    case LogLevel::Fatal: return "FATAL";
+    case LogLevel::Error: return "ERROR";
+    case LogLevel::Warning: return "WARN";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Trace: return "TRACE";
+    case LogLevel::All: return "ALL";
+    default: return "?";
+    }
+}
+
+} // namespace internal
+
+class Layout;
+
+// What sinks receive. ctx is the context timber-c would get, with the
+// message and the timestamp filled in.
+struct Record {
+    c::tmb_log_ctx_t ctx;
+    std::string_view logger;
+    // set with Logger::set_layout, render_default falls back to the default
+    const Layout* layout = nullptr;
+    // the thread that logged the record
+    const internal::ThreadInfo* thread = nullptr;
+
+    LogLevel level() const noexcept {
+        return static_cast<LogLevel>(ctx.log_level);
+    }
+
+    std::string_view message() const noexcept {
+        return { ctx.message, static_cast<std::size_t>(ctx.message_len) };
+    }
+};
+
+// A record that owns its message, for sinks that keep records past the
+// write() call. One is made per record and shared by all such sinks, the
+// logger name and layout stay valid until the logger has flushed its sinks
+// on destruction.
+class SharedRecord {
+  public:
+    explicit SharedRecord(const Record& rec) :
+        _message(rec.message()), _record(rec) {
+        _record.ctx.message = _message.data();
+    }
+
+    SharedRecord(const SharedRecord&)            = delete;
+    SharedRecord& operator=(const SharedRecord&) = delete;
+
+    const Record& record() const noexcept { return _record; }
+
+  private:
+    std::string _message;
+    Record _record;
+};
+
+// A C++-side destination for records. A Logger with sinks writes to them
+// instead of timber-c. write() is called from every logging thread (or the
+// async writer), implementations do their own locking.
+class Sink {
+  public:
+    virtual ~Sink() = default;
+
+    virtual void write(const Record& rec) = 0;
+
+    // The records of a Logger::batch, in order. Sinks that take a lock or
+    // make a syscall per record override it to pay for them once.
+    virtual void write_batch(std::span<const Record> recs) {
+        for (const auto& rec : recs) write(rec);
+    }
+
+    // Sinks that queue records return true and get them through
+    // write_shared instead of write: the record is copied once however many
+    // of them a logger fans out to. Asked once, when the sink is added.
+    virtual bool shares_records() const noexcept { return false; }
+    virtual void write_shared(std::shared_ptr<const SharedRecord> rec) {
+        write(rec->record());
+    }
+
+    virtual void flush() {}
+    // Called from tmb::emergency_flush, i.e. from a fatal signal handler:
+    // write out what's buffered using async-signal-safe calls only, and
+    // give up rather than wait for a lock.
+    virtual void emergency_flush() noexcept {}
+};
+
+namespace internal {
+
+// "2026-01-31 12:00:00", local time. Formatting the date is the expensive
+// part and it only changes once a second.
+inline std::string_view local_datetime(std::int64_t sec) {
+    thread_local std::int64_t cached_sec = -1;
+    thread_local char cached[32];
+    thread_local std::size_t cached_len = 0;
+    if (sec != cached_sec) {
+        std::time_t t = static_cast<std::time_t>(sec);
+        std::tm tm {};
+        localtime_r(&t, &tm);
+        cached_len = std::strftime(cached, sizeof(cached), "%F %T", &tm);
+        cached_sec = sec;
+    }
+    return { cached, cached_len };
+}
+
+inline std::string_view level_color(LogLevel level) noexcept {
+    switch (level) {
+    case LogLevel::Fatal: return "\033[1;31m";
+    case LogLevel::Error: return "\033[31m";
+    case LogLevel::Warning: return "\033[33m";
+    case LogLevel::Info: return "\033[32m";
+    case LogLevel::Debug: return "\033[36m";
+    case LogLevel::Trace: return "\033[90m";
+    default: return "";
+    }
+}
+
+template <LayoutField F>
+void render_field(const Record& rec, std::string& out) {
+    const auto& ctx = rec.ctx;
+    auto it         = std::back_inserter(out);
+    auto text       = [](const char* s, int len) {
+        return std::string_view(s, static_cast<std::size_t>(len));
+    };
+    if constexpr (F == LayoutField::Date) {
+        out.append(local_datetime(ctx.ts_sec).substr(0, 10));
+    } else if constexpr (F == LayoutField::Time) {
+        out.append(local_datetime(ctx.ts_sec).substr(11, 8));
+    } else if constexpr (F == LayoutField::Millis) {
+        std::format_to(it, "{:03}", ctx.ts_nsec / 1'000'000);
+    } else if constexpr (F == LayoutField::Micros) {
+        std::format_to(it, "{:06}", ctx.ts_nsec / 1'000);
+    } else if constexpr (F == LayoutField::Nanos) {
+        std::format_to(it, "{:09}", ctx.ts_nsec);
+    } else if constexpr (F == LayoutField::Epoch) {
+        std::format_to(it, "{}", ctx.ts_sec);
+    } else if constexpr (F == LayoutField::Level) {
+        out.append(level_name(rec.level()));
+    } else if constexpr (F == LayoutField::LevelColor) {
+        out.append(level_color(rec.level()));
+    } else if constexpr (F == LayoutField::Logger) {
+        out.append(rec.logger);
+    } else if constexpr (F == LayoutField::File) {
+        out.append(text(ctx.filename_base, ctx.filename_base_len));
+    } else if constexpr (F == LayoutField::Path) {
+        out.append(text(ctx.filename, ctx.filename_len));
+    } else if constexpr (F == LayoutField::Line) {
+        std::format_to(it, "{}", ctx.line_no);
+    } else if constexpr (F == LayoutField::Func) {
+        out.append(text(ctx.funcname, ctx.funcname_len));
+    } else if constexpr (F == LayoutField::Message) {
+        out.append(rec.message());
+    } else if constexpr (F == LayoutField::Thread) {
+        if (rec.thread && !rec.thread->name.empty()) {
+            out.append(rec.thread->name);
+        } else {
+            std::format_to(it, "{}", rec.thread ? rec.thread->tid : 0);
+        }
+    } else if constexpr (F == LayoutField::Tid) {
+        std::format_to(it, "{}", rec.thread ? rec.thread->tid : 0);
+    }
+}
+
+template <LayoutField F>
+void render_field(const Record& rec, std::string& out, std::uint32_t width) {
+    auto start = out.size();
+    render_field<F>(rec, out);
+    auto n = out.size() - start;
+    if (n < width) out.append(width - n, ' ');
+}
+
+// A pattern compiled at compile time: the op list is unrolled and each
+// literal is a copy of known size
+template <fixed_string Pattern, bool Colors>
+struct StaticLayout {
+    static constexpr auto program = [] {
+        StaticLayoutProgram<Pattern.view().size()> p;
+        p.ok = parse_layout(Pattern.view(), p, Colors);
+        return p;
+    }();
+    static_assert(program.ok, "invalid layout pattern");
+
+    template <LayoutOp Op>
+    static void step(const Record& rec, std::string& out) {
+        if constexpr (Op.field == LayoutField::Literal) {
+            out.append(program.chars + Op.offset, Op.width);
+        } else if constexpr (Op.width == 0) {
+            render_field<Op.field>(rec, out);
+        } else {
+            render_field<Op.field>(rec, out, Op.width);
+        }
+    }
+
+    static void render(const Record& rec, std::string& out) {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (step<program.ops[I]>(rec, out), ...);
+        }(std::make_index_sequence<program.op_count>());
+    }
+};
+
+inline void render_op(const LayoutOp& op,
+                      const LayoutProgram& program,
+                      const Record& rec,
+                      std::string& out) {
+    switch (op.field) {
+#define _tmb_ccp_LAYOUT_FIELD__(FIELD)                                         \
+    case LayoutField::FIELD:                                                   \
+        render_field<LayoutField::FIELD>(rec, out, op.width);                  \
+        break
+    case LayoutField::Literal:
+        out.append(program.chars, op.offset, op.width);
+        break;
+    _tmb_ccp_LAYOUT_FIELD__(Date);
+    _tmb_ccp_LAYOUT_FIELD__(Time);
+    _tmb_ccp_LAYOUT_FIELD__(Millis);
+    _tmb_ccp_LAYOUT_FIELD__(Micros);
+    _tmb_ccp_LAYOUT_FIELD__(Nanos);
+    _tmb_ccp_LAYOUT_FIELD__(Epoch);
+    _tmb_ccp_LAYOUT_FIELD__(Level);
+    _tmb_ccp_LAYOUT_FIELD__(LevelColor);
+    _tmb_ccp_LAYOUT_FIELD__(Logger);
+    _tmb_ccp_LAYOUT_FIELD__(File);
+    _tmb_ccp_LAYOUT_FIELD__(Path);
+    _tmb_ccp_LAYOUT_FIELD__(Line);
+    _tmb_ccp_LAYOUT_FIELD__(Func);
+    _tmb_ccp_LAYOUT_FIELD__(Message);
+    _tmb_ccp_LAYOUT_FIELD__(Thread);
+    _tmb_ccp_LAYOUT_FIELD__(Tid);
+#undef _tmb_ccp_LAYOUT_FIELD__
+    }
+}
+
+inline constexpr fixed_string default_layout {
+    "{date} {time}.{ms} {level:5} [{logger}] {file}:{line} {msg}\n"
+};
+
+} // namespace internal
+
+enum class ColorMode {
+    // colors if the output is a terminal, see internal::colors_wanted
+    Auto,
+    Always,
+    Never,
+};
+
+// How sinks render records: a pattern compiled once into a list of ops, so
+// writing a record doesn't parse or interpret the pattern. See
+// internal::parse_layout for the syntax. Records going to timber-c use the
+// pattern given to set_default_format instead.
+//
+// Each layout is compiled twice, with and without the color escapes; a
+// sink decides once which of the two it renders.
+class Layout {
+    using RenderFn = void (*)(const Record&, std::string&);
+
+  public:
+    // "2026-01-31 12:00:00.123 INFO  [name] file.cpp:42 message\n"
+    Layout() noexcept = default;
+
+    explicit Layout(std::string_view pattern) {
+        if (!internal::parse_layout(pattern, _colored, true)) {
+            throw std::invalid_argument("Invalid layout pattern");
+        }
+        internal::parse_layout(pattern, _plain, false);
+        _render = _render_colored = nullptr;
+    }
+
+    // Checked and compiled at compile time, the literal text between fields
+    // (colors included) is folded into one copy of constant size
+    template <internal::fixed_string Pattern>
+    static Layout compiled() noexcept {
+        using internal::StaticLayout;
+        Layout layout;
+        layout._render         = &StaticLayout<Pattern, false>::render;
+        layout._render_colored = &StaticLayout<Pattern, true>::render;
+        return layout;
+    }
+
+    void render(const Record& rec, std::string& out, bool colors) const {
+        if (auto fn = colors ? _render_colored : _render) return fn(rec, out);
+        const auto& program = colors ? _colored : _plain;
+        for (const auto& op : program.ops) {
+            internal::render_op(op, program, rec, out);
+        }
+    }
+
+  private:
+    RenderFn _render =
+            &internal::StaticLayout<internal::default_layout, false>::render;
+    RenderFn _render_colored =
+            &internal::StaticLayout<internal::default_layout, true>::render;
+    internal::LayoutProgram _plain;
+    internal::LayoutProgram _colored;
+};
+
+namespace internal {
+
+inline bool use_colors(ColorMode mode, int fd) noexcept {
+    switch (mode) {
+    case ColorMode::Always: return true;
+    case ColorMode::Never: return false;
+    default: return colors_wanted(fd);
+    }
+}
+
+// With the logger's layout, the default one if it has none. Sinks pass the
+// color decision they made when they were set up.
+inline void render_default(const Record& rec,
+                           std::string& out,
+                           bool colors = false) {
+    if (rec.layout) {
+        rec.layout->render(rec, out, colors);
+    } else {
+        StaticLayout<default_layout, false>::render(rec, out);
+    }
+}
+
+// One record of a Logger::batch, its message is at [offset, offset + size)
+// of the batch's text
+struct BatchRecord {
+    LogLevel level;
+    SourceMeta meta;
+    Timestamp ts;
+    std::size_t offset;
+    std::size_t size;
+};
+
+struct BatchBuffers {
+    std::vector<BatchRecord> records;
+    std::string text;
+    bool in_use = false;
+};
+
+// kept per thread like the message buffers, so a batch doesn't allocate
+// once the thread has logged one of its size
+inline BatchBuffers& thread_batch_buffers() noexcept {
+    thread_local BatchBuffers buffers;
+    return buffers;
+}
+
+// Where a Logger's records end up: its sinks if it has any, timber-c
+// otherwise. Heap allocated so the async writer can keep a pointer to it
+// across Logger moves.
+class Dispatcher final : public EmergencyFlush {
+  public:
+    Dispatcher(c::tmb_logger_t* handle, std::string_view name) :
+        _handle(handle), _name(name), _slot(EmergencyRegistry::add(this)) {
+        StatsRegistry::add(_name, _stats);
+    }
+
+    ~Dispatcher() {
+        StatsRegistry::remove(_stats);
+        EmergencyRegistry::remove(_slot);
+        // queued shared records point at _name and the layouts
+        flush();
+    }
+
+    Dispatcher(const Dispatcher&)            = delete;
+    Dispatcher& operator=(const Dispatcher&) = delete;
+
+    const std::string& name() const noexcept { return _name; }
+
+    // the logger's counters, shared with its async writer
+    StatsCounters& stats() noexcept { return _stats; }
+    const StatsCounters& stats() const noexcept { return _stats; }
+
+    void add_sink(std::shared_ptr<Sink> sink) {
+        auto shares = sink->shares_records();
+        while (_sinks_busy.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        try {
+            _sinks.push_back({ std::move(sink), shares });
+        } catch (...) {
+            _sinks_busy.store(false, std::memory_order_release);
+            throw;
+        }
+        _sinks_busy.store(false, std::memory_order_release);
+    }
+
+    bool has_sinks() const noexcept { return !_sinks.empty(); }
+
+    void set_layout(Layout layout) {
+        std::lock_guard lock(_layout_mutex);
+        _layouts.push_back(std::make_unique<const Layout>(std::move(layout)));
+        _layout.store(_layouts.back().get(), std::memory_order_release);
+    }
+
+    // a null thread is the calling one
+    void write(LogLevel level,
+               const SourceMeta& meta,
+               Timestamp ts,
+               std::string_view msg,
+               Timestamp stopwatch      = {},
+               const ThreadInfo* thread = nullptr) noexcept {
+        auto ctx = LogContext(level, meta, resolve_time(ts), stopwatch).to_c();
+        if (_sinks.empty()) {
+            emit(_handle, ctx, msg);
+            return;
+        }
+        ctx.message     = msg.data();
+        ctx.message_len = static_cast<int>(msg.size());
+        Record rec { ctx,
+                     _name,
+                     _layout.load(std::memory_order_acquire),
+                     thread ? thread : current_thread() };
+        std::shared_ptr<const SharedRecord> shared;
+        for (auto& [sink, shares] : _sinks) {
+            // a failing sink must not take the others (or the caller) down
+            try {
+                if (!shares) {
+                    sink->write(rec);
+                    continue;
+                }
+                if (!shared) shared = std::make_shared<const SharedRecord>(rec);
+                sink->write_shared(shared);
+            } catch (...) {
+            }
+        }
+    }
+
+    // timber-c only takes records one at a time, sinks get the whole batch
+    void write_batch(std::span<const BatchRecord> recs,
+                     std::string_view text) noexcept {
+        if (_sinks.empty()) {
+            for (const auto& r : recs) {
+                emit(_handle,
+                     LogContext(r.level, r.meta, resolve_time(r.ts)).to_c(),
+                     text.substr(r.offset, r.size));
+            }
+            return;
+        }
+        std::vector<Record> out;
+        try {
+            out.reserve(recs.size());
+        } catch (...) {
+            return;
+        }
+        auto* layout = _layout.load(std::memory_order_acquire);
+        auto* thread = current_thread();
+        for (const auto& r : recs) {
+            auto ctx = LogContext(r.level, r.meta, resolve_time(r.ts)).to_c();
+            ctx.message     = text.data() + r.offset;
+            ctx.message_len = static_cast<int>(r.size);
+            out.push_back({ ctx, _name, layout, thread });
+        }
+        std::vector<std::shared_ptr<const SharedRecord>> shared;
+        for (auto& [sink, shares] : _sinks) {
+            try {
+                if (!shares) {
+                    sink->write_batch(out);
+                    continue;
+                }
+                if (shared.empty()) {
+                    std::vector<std::shared_ptr<const SharedRecord>> copies;
+                    copies.reserve(out.size());
+                    for (const auto& rec : out) {
+                        copies.push_back(
+                                std::make_shared<const SharedRecord>(rec));
+                    }
+                    shared = std::move(copies);
+                }
+                for (const auto& rec : shared) sink->write_shared(rec);
+            } catch (...) {
+            }
+        }
+    }
+
+    void flush() noexcept {
+        for (auto& entry : _sinks) {
+            try {
+                entry.sink->flush();
+            } catch (...) {
+            }
+        }
+    }
+
+    // skips the sinks while one is being added
+    void emergency_flush(int) noexcept override {
+        if (_sinks_busy.exchange(true, std::memory_order_acquire)) return;
+        for (auto& entry : _sinks) entry.sink->emergency_flush();
+        _sinks_busy.store(false, std::memory_order_release);
+    }
+
+  private:
+    struct SinkEntry {
+        std::shared_ptr<Sink> sink;
+        bool shares;
+    };
+
+    c::tmb_logger_t* _handle;
+    std::string _name;
+    std::vector<SinkEntry> _sinks;
+    // held by add_sink and emergency_flush, which may run alongside it
+    std::atomic<bool> _sinks_busy { false };
+    // replaced layouts are kept, a writer may still be rendering with one
+    std::mutex _layout_mutex;
+    std::vector<std::unique_ptr<const Layout>> _layouts;
+    std::atomic<const Layout*> _layout { nullptr };
+    StatsCounters _stats;
+    int _slot;
+};
+
+inline constexpr std::size_t async_inline_message = 256;
+
+template <typename T>
+concept deferred_string =
+        std::same_as<T, std::string> || std::same_as<T, std::string_view> ||
+        std::same_as<T, const char*> || std::same_as<T, char*> ||
+        (std::is_array_v<T> && std::same_as<std::remove_extent_t<T>, char>);
+
+template <typename T>
+concept deferred_arg = deferred_string<std::remove_cvref_t<T>> ||
+                       is_deferrable<std::remove_cvref_t<T>>::value;
+
+// Deferred arguments are packed back to back: strings as a length followed
+// by the bytes (read back as a string_view into the record), everything else
+// as its object representation.
+template <typename T>
+std::size_t deferred_size(const T& arg) noexcept {
+    if constexpr (deferred_string<T>) {
+        return sizeof(std::size_t) + std::string_view(arg).size();
+    } else {
+        return sizeof(T);
+    }
+}
+
+template <typename T>
+void deferred_encode(char*& out, const T& arg) noexcept {
+    if constexpr (deferred_string<T>) {
+        std::string_view str(arg);
+        auto len = str.size();
+        std::memcpy(out, &len, sizeof(len));
+        std::memcpy(out + sizeof(len), str.data(), len);
+        out += sizeof(len) + len;
+    } else {
+        std::memcpy(out, &arg, sizeof(T));
+        out += sizeof(T);
+    }
+}
+
+template <typename T>
+using deferred_decoded_t =
+        std::conditional_t<deferred_string<T>, std::string_view, T>;
+
+template <typename T>
+deferred_decoded_t<T> deferred_decode(const char*& in) noexcept {
+    if constexpr (deferred_string<T>) {
+        std::size_t len;
+        std::memcpy(&len, in, sizeof(len));
+        std::string_view str(in + sizeof(len), len);
+        in += sizeof(len) + len;
+        return str;
+    } else {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::memcpy(storage, in, sizeof(T));
+        in += sizeof(T);
+        return *std::launder(reinterpret_cast<T*>(storage));
+    }
+}
+
+using DeferredRender = std::string_view (*)(MessageBuffer& buf,
+                                            LogLevel& level,
+                                            std::string_view fmt,
+                                            const char* payload);
+
+template <typename... Args>
+std::string_view render_deferred(MessageBuffer& buf,
+                                 LogLevel& level,
+                                 std::string_view fmt,
+                                 [[maybe_unused]] const char* payload) {
+    // braced initialization decodes left to right
+    std::tuple<deferred_decoded_t<Args>...> values {
+        deferred_decode<Args>(payload)...
+    };
+    return std::apply(
+            [&](auto&... v) { return format_message(buf, level, fmt, v...); },
+            values);
+}
+
+template <typename T>
+void emergency_arg(EmergencyWriter& out, const T& v) noexcept {
+    if constexpr (std::same_as<T, std::string_view>) {
+        out.append(v);
+    } else if constexpr (std::same_as<T, bool>) {
+        out.append(std::string_view(v ? "true" : "false"));
+    } else if constexpr (std::same_as<T, char>) {
+        out.append(std::string_view(&v, 1));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        out.append(static_cast<std::int64_t>(v));
+    } else if constexpr (std::is_integral_v<T>) {
+        out.append(static_cast<std::uint64_t>(v));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        out.append(static_cast<double>(v));
+    } else if constexpr (std::is_enum_v<T>) {
+        emergency_arg(out, static_cast<std::underlying_type_t<T>>(v));
+    } else {
+        out.append(std::string_view("{?}"));
+    }
+}
+
+using DeferredEmergency = void (*)(EmergencyWriter& out,
+                                   std::string_view fmt,
+                                   const char* payload) noexcept;
+
+// Async-signal-safe stand-in for render_deferred: substitutes the decoded
+// arguments for the replacement fields, ignoring format specs
+template <typename... Args>
+void emergency_deferred(EmergencyWriter& out,
+                        std::string_view fmt,
+                        [[maybe_unused]] const char* payload) noexcept {
+    std::tuple<deferred_decoded_t<Args>...> values {
+        deferred_decode<Args>(payload)...
+    };
+    std::size_t next = 0;
+    auto arg         = [&](std::size_t index) noexcept {
+        std::size_t i = 0;
+        std::apply(
+                [&](const auto&... v) {
+                    ((i++ == index ? emergency_arg(out, v) : void()), ...);
+                },
+                values);
+        if (index >= sizeof...(Args)) out.append(std::string_view("{?}"));
+    };
+    for (std::size_t i = 0; i < fmt.size(); ++i) {
+        auto c = fmt[i];
+        if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c) {
+            out.append(fmt.substr(i++, 1));
+        } else if (c == '{') {
+            auto end = fmt.find('}', i);
+            if (end == std::string_view::npos) break;
+            // an explicit index, if any, comes first
+            std::size_t index = 0;
+            bool indexed      = false;
+            for (auto k = i + 1; k < end && fmt[k] >= '0' && fmt[k] <= '9';
+                 ++k) {
+                index   = index * 10 + static_cast<std::size_t>(fmt[k] - '0');
+                indexed = true;
+            }
+            arg(indexed ? index : next++);
+            i = end;
+        } else {
+            out.append(fmt.substr(i, 1));
+        }
+    }
+}
+
+// One queued record. Messages up to async_inline_message bytes are stored in
+// the cell itself, longer ones in a chain of arena chunks or, when the arena
+// is out of chunks, a string. Deferred records keep their packed arguments
+// in bytes and the function that formats them.
+struct AsyncRecord {
+    LogLevel level { LogLevel::None };
+    SourceMeta meta;
+    Timestamp ts;
+    Timestamp stopwatch;
+    std::size_t size { 0 };
+    std::array<char, async_inline_message> bytes;
+    std::string overflow;
+    std::string_view fmt;
+    DeferredRender render { nullptr };
+    DeferredEmergency emergency { nullptr };
+    std::uint32_t chunks { ChunkPool::none };
+    const ThreadInfo* thread { nullptr };
+
+    void assign(LogLevel lvl,
+                const SourceMeta& m,
+                Timestamp t,
+                std::string_view msg,
+                Timestamp sw,
+                ChunkPool* pool) noexcept {
+        level     = lvl;
+        meta      = m;
+        ts        = t;
+        stopwatch = sw;
+        render    = nullptr;
+        chunks    = ChunkPool::none;
+        if (msg.size() > bytes.size()) {
+            if (pool) chunks = pool->store(msg);
+            if (chunks != ChunkPool::none) {
+                size = msg.size();
+                return;
+            }
+            try {
+                overflow.assign(msg);
+                size = msg.size();
+                return;
+            } catch (...) {
+                msg = msg.substr(0, bytes.size());
+            }
+        }
+        size = msg.copy(bytes.data(), msg.size());
+    }
+
+    template <typename... Args>
+    void assign_deferred(LogLevel lvl,
+                         const SourceMeta& m,
+                         Timestamp t,
+                         std::string_view format,
+                         const Args&... args) noexcept {
+        level     = lvl;
+        meta      = m;
+        ts        = t;
+        stopwatch = {};
+        chunks    = ChunkPool::none;
+        fmt       = format;
+        render    = &render_deferred<Args...>;
+        emergency = &emergency_deferred<Args...>;
+        auto* out = bytes.data();
+        (deferred_encode(out, args), ...);
+        size = static_cast<std::size_t>(out - bytes.data());
+    }
+
+    // not for records whose message is in arena chunks
+    std::string_view message() const noexcept {
+        if (size > bytes.size()) { return overflow; }
+        return { bytes.data(), size };
+    }
+};
+
+// One queue, the arena for its long messages and the count of records taken
+// out of it, by the writer or by DropOldest producers
+struct AsyncLane {
+    AsyncLane(std::size_t capacity, std::size_t chunks) :
+        queue(capacity),
+        pool(chunks ? std::make_unique<ChunkPool>(chunks) : nullptr) {}
+
+    BoundedQueue<AsyncRecord> queue;
+    std::unique_ptr<ChunkPool> pool;
+    std::thread::id owner;
+    alignas(cache_line_size) std::atomic<std::size_t> retired { 0 };
+};
+
+inline constexpr std::size_t async_max_lanes   = 128;
+inline constexpr std::size_t async_drain_batch = 64;
+
+// Owns the queues and the thread that drains them into timber-c. Producers
+// only touch their queue and, when the writer is asleep, a futex word.
+class AsyncWorker final : public EmergencyFlush {
+  public:
+    AsyncWorker(Dispatcher* out, const AsyncOptions& opts) :
+        _out(out),
+        _overflow(opts.overflow),
+        _deferred(opts.deferred),
+        _per_thread(opts.per_thread),
+        _lane_capacity(opts.lane_capacity),
+        _lane_chunks(opts.lane_arena_chunks),
+        _id(next_id()),
+        _lanes(std::make_unique<AsyncLane*[]>(
+                _per_thread ? async_max_lanes : 1)) {
+        _owned.push_back(
+                std::make_unique<AsyncLane>(opts.capacity, opts.arena_chunks));
+        _lanes[0] = _owned.back().get();
+        _thread   = std::thread([this] { run(); });
+        _slot     = EmergencyRegistry::add(this);
+    }
+
+    ~AsyncWorker() { stop(); }
+
+    AsyncWorker(const AsyncWorker&)            = delete;
+    AsyncWorker& operator=(const AsyncWorker&) = delete;
+
+    void push(LogLevel level,
+              const SourceMeta& meta,
+              Timestamp ts,
+              std::string_view msg,
+              Timestamp stopwatch = {}) noexcept {
+        auto* thread = current_thread();
+        enqueue([&](AsyncRecord& rec, ChunkPool* pool) noexcept {
+            rec.assign(level, meta, ts, msg, stopwatch, pool);
+            rec.thread = thread;
+        });
+    }
+
+    // the writer is woken once for the whole batch
+    void push_batch(std::span<const BatchRecord> recs,
+                    std::string_view text) noexcept {
+        auto* thread = current_thread();
+        for (const auto& r : recs) {
+            put([&](AsyncRecord& rec, ChunkPool* pool) noexcept {
+                rec.assign(r.level,
+                           r.meta,
+                           r.ts,
+                           text.substr(r.offset, r.size),
+                           {},
+                           pool);
+                rec.thread = thread;
+            });
+        }
+        notify();
+    }
+
+    bool deferred() const noexcept { return _deferred; }
+
+    // false when the packed arguments don't fit in a record, the caller
+    // formats eagerly then
+    template <typename... Args>
+    bool push_deferred(LogLevel level,
+                       const SourceMeta& meta,
+                       Timestamp ts,
+                       std::string_view fmt,
+                       const Args&... args) noexcept {
+        if ((deferred_size(args) + ... + 0) > async_inline_message) {
+            return false;
+        }
+        auto* thread = current_thread();
+        enqueue([&](AsyncRecord& rec, ChunkPool*) noexcept {
+            rec.assign_deferred(level, meta, ts, fmt, args...);
+            rec.thread = thread;
+        });
+        return true;
+    }
+
+    // Returns once everything pushed before the call has been written. The
+    // writer thread itself (a sink or layout that logs, a fatal record) can't
+    // wait for its own progress, and draining from inside a pop isn't safe:
+    // there it returns right away, what it pushed follows the record being
+    // written.
+    void flush() noexcept {
+        if (on_writer()) return;
+        auto count = _lane_count.load(std::memory_order_acquire);
+        std::vector<std::size_t> targets;
+        try {
+            targets.resize(count);
+        } catch (...) {
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            targets[i] = _lanes[i]->queue.pushed();
+        }
+        wake();
+        for (std::size_t i = 0; i < count; ++i) {
+            while (_lanes[i]->retired.load(std::memory_order_acquire) <
+                   targets[i]) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::uint64_t dropped() const noexcept { return _out->stats().drops(); }
+
+    // writes out what's queued and joins the writer, which may still log
+    // through the logger meanwhile
+    void stop() noexcept {
+        if (!_thread.joinable()) return;
+        EmergencyRegistry::remove(_slot);
+        _slot = -1;
+        _stop.store(true, std::memory_order_release);
+        wake();
+        _thread.join();
+    }
+
+    // Takes the queued records out from under the writer thread and writes
+    // them to fd as "LEVEL [name] file:line message". std::format isn't
+    // signal-safe, deferred records get a plain substitution of their
+    // arguments instead.
+    void emergency_flush(int fd) noexcept override {
+        EmergencyWriter out(fd);
+        ChunkPool* pool = nullptr; // the lane's being flushed
+        auto write      = [&](AsyncRecord& rec) noexcept {
+            out.append(level_name(rec.level));
+            out.append(" [");
+            out.append(_out->name());
+            out.append("] ");
+            out.append(std::string_view(rec.meta.filename_base,
+                                        static_cast<std::size_t>(
+                                                rec.meta.filename_base_len)));
+            out.append(":");
+            out.append(static_cast<std::int64_t>(rec.meta.line));
+            out.append(" ");
+            if (rec.render) {
+                rec.emergency(out, rec.fmt, rec.bytes.data());
+            } else if (rec.chunks != ChunkPool::none) {
+                pool->for_each(rec.chunks,
+                               [&](std::string_view s) { out.append(s); });
+                pool->release(rec.chunks);
+            } else {
+                out.append(rec.message());
+            }
+            out.append("\n");
+        };
+        auto count = _lane_count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < count; ++i) {
+            auto& l = *_lanes[i];
+            pool    = l.pool.get();
+            while (l.queue.try_pop(write)) {
+                l.retired.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+  private:
+    // tells workers apart in the per-thread lane caches, unlike addresses
+    // ids are never reused
+    static std::uint64_t next_id() noexcept {
+        static std::atomic<std::uint64_t> id { 0 };
+        return id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    AsyncLane& lane() noexcept {
+        if (!_per_thread) return *_lanes[0];
+        struct Cached {
+            std::uint64_t worker { 0 };
+            AsyncLane* lane { nullptr };
+        };
+        thread_local std::array<Cached, 4> cache {};
+        thread_local std::size_t next = 0;
+        for (auto& c : cache) {
+            if (c.worker == _id) return *c.lane;
+        }
+        auto* found                  = find_lane();
+        cache[next++ % cache.size()] = { _id, found };
+        return *found;
+    }
+
+    // the calling thread's lane, registering a new one on its first record
+    AsyncLane* find_lane() noexcept {
+        auto self = std::this_thread::get_id();
+        std::lock_guard lock(_lanes_mutex);
+        auto count = _lane_count.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (_lanes[i]->owner == self) return _lanes[i];
+        }
+        if (count == async_max_lanes) {
+            return _lanes[std::hash<std::thread::id> {}(self) % count];
+        }
+        // lane 0 stays with whoever didn't get one of their own
+        try {
+            _owned.push_back(
+                    std::make_unique<AsyncLane>(_lane_capacity, _lane_chunks));
+        } catch (...) {
+            return _lanes[0];
+        }
+        auto* lane    = _owned.back().get();
+        lane->owner   = self;
+        _lanes[count] = lane;
+        _lane_count.store(count + 1, std::memory_order_release);
+        return lane;
+    }
+
+    template <typename Fill>
+    void enqueue(Fill&& fill) noexcept {
+        put(fill);
+        notify();
+    }
+
+    // fill(AsyncRecord&, ChunkPool*) gets the arena of the lane it's put in
+    template <typename Fill>
+    void put(Fill&& fill) noexcept {
+        auto& l   = lane();
+        auto cell = [&](AsyncRecord& rec) noexcept { fill(rec, l.pool.get()); };
+        while (!l.queue.try_push(cell)) {
+            if (_overflow == OverflowPolicy::DropNewest) {
+                _out->stats().dropped();
+                return;
+            } else if (_overflow == OverflowPolicy::DropOldest) {
+                auto discard = [&l](AsyncRecord& rec) noexcept {
+                    if (rec.chunks != ChunkPool::none) {
+                        l.pool->release(rec.chunks);
+                    }
+                };
+                if (l.queue.try_pop(discard)) {
+                    _out->stats().dropped();
+                    l.retired.fetch_add(1, std::memory_order_release);
+                }
+            } else if (on_writer()) {
+                // nobody else would ever make room
+                _out->stats().dropped();
+                return;
+            } else {
+                // a batch only wakes the writer at its end
+                notify();
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool on_writer() const noexcept {
+        return std::this_thread::get_id() == _thread.get_id();
+    }
+
+    void run() noexcept {
+        for (;;) {
+            if (drain() > 0) continue;
+            if (_stop.load(std::memory_order_acquire)) {
+                if (drain() == 0) break;
+                continue;
+            }
+            wait_for_work();
+        }
+    }
+
+    // one pass over all lanes, at most a batch from each so a busy thread
+    // can't starve the others
+    std::size_t drain() noexcept {
+        std::size_t n   = 0;
+        ChunkPool* pool = nullptr; // the lane's being drained
+        auto write      = [&](AsyncRecord& rec) noexcept {
+            if (rec.render) {
+                auto level = rec.level;
+                MessageBuffer buf;
+                auto msg = rec.render(buf, level, rec.fmt, rec.bytes.data());
+                _out->stats().formatted(msg.size(), buf.failed());
+                _out->write(level, rec.meta, rec.ts, msg, {}, rec.thread);
+            } else if (rec.chunks != ChunkPool::none) {
+                // one copy to make the message contiguous for the sinks
+                MessageBuffer buf;
+                try {
+                    pool->read(rec.chunks, buf.str());
+                } catch (...) {
+                }
+                pool->release(rec.chunks);
+                _out->write(rec.level,
+                            rec.meta,
+                            rec.ts,
+                            buf.str(),
+                            rec.stopwatch,
+                            rec.thread);
+            } else {
+                _out->write(rec.level,
+                            rec.meta,
+                            rec.ts,
+                            rec.message(),
+                            rec.stopwatch,
+                            rec.thread);
+            }
+        };
+        auto count = _lane_count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < count; ++i) {
+            auto& l = *_lanes[i];
+            pool    = l.pool.get();
+            // the queue is at its fullest right before it's drained
+            _out->stats().queue_depth(l.queue.size());
+            for (std::size_t k = 0; k < async_drain_batch; ++k) {
+                if (!l.queue.try_pop(write)) break;
+                l.retired.fetch_add(1, std::memory_order_release);
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    bool empty() const noexcept {
+        auto count = _lane_count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (_lanes[i]->queue.size() != 0) return false;
+        }
+        return true;
+    }
+
+    // The fences pair with the one in notify(): either the writer sees the
+    // new record or the producer sees it sleeping and bumps the futex word.
+    void wait_for_work() noexcept {
+        auto signal = _signal.load(std::memory_order_acquire);
+        _sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (empty() && !_stop.load(std::memory_order_relaxed)) {
+            _signal.wait(signal, std::memory_order_acquire);
+        }
+        _sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    void notify() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleeping.load(std::memory_order_relaxed)) { wake(); }
+    }
+
+    void wake() noexcept {
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_one();
+    }
+
+    Dispatcher* _out;
+    OverflowPolicy _overflow;
+    bool _deferred;
+    bool _per_thread;
+    std::size_t _lane_capacity;
+    std::size_t _lane_chunks;
+    std::uint64_t _id;
+    // _lanes[0, _lane_count) are published and never change afterwards
+    std::unique_ptr<AsyncLane*[]> _lanes;
+    std::atomic<std::size_t> _lane_count { 1 };
+    std::mutex _lanes_mutex; // guards _owned and lane registration
+    std::vector<std::unique_ptr<AsyncLane>> _owned;
+    alignas(cache_line_size) std::atomic<std::uint32_t> _signal { 0 };
+    std::atomic<bool> _sleeping { false };
+    std::atomic<bool> _stop { false };
+    std::thread _thread;
+    int _slot { -1 };
+};
+
+template <typename T>
+concept binary_arg = deferred_string<T> || std::is_integral_v<T> ||
+                     std::same_as<T, float> || std::same_as<T, double> ||
+                     std::same_as<T, const void*> || std::same_as<T, void*> ||
+                     std::same_as<T, std::nullptr_t>;
+
+template <typename T>
+void binary_encode(std::string& out, const T& arg) {
+    using binary::Arg;
+    using binary::put;
+    if constexpr (deferred_string<T>) {
+        put(out, Arg::String);
+        binary::put_str(out, std::string_view(arg));
+    } else if constexpr (std::same_as<T, bool>) {
+        put(out, Arg::Bool);
+        put(out, static_cast<std::uint64_t>(arg));
+    } else if constexpr (std::same_as<T, char>) {
+        put(out, Arg::Char);
+        put(out, static_cast<std::uint64_t>(static_cast<unsigned char>(arg)));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        put(out, Arg::Int);
+        put(out, static_cast<std::int64_t>(arg));
+    } else if constexpr (std::is_integral_v<T>) {
+        put(out, Arg::UInt);
+        put(out, static_cast<std::uint64_t>(arg));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        put(out, Arg::Double);
+        put(out, static_cast<double>(arg));
+    } else {
+        put(out, Arg::Pointer);
+        put(out, static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(
+                static_cast<const void*>(arg))));
+    }
+}
+
+// Writes the compact binary format described in internal/binary_format.hpp.
+// Call sites are identified by their format string and location, each one
+// gets an id and a string table entry the first time it logs.
+class BinaryWriter {
+  public:
+    BinaryWriter(std::FILE* file, std::string_view logger_name) :
+        _file(file) {
+        std::setvbuf(_file, nullptr, _IOFBF, 64 * 1024);
+        std::string header(binary::magic, sizeof(binary::magic));
+        binary::put(header, binary::version);
+        binary::put_str(header, logger_name);
+        std::fwrite(header.data(), 1, header.size(), _file);
+    }
+
+    ~BinaryWriter() { std::fclose(_file); }
+
+    BinaryWriter(const BinaryWriter&)            = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+    template <typename... Args>
+    void write(LogLevel level,
+               const SourceMeta& meta,
+               std::string_view fmt,
+               Timestamp ts,
+               const Args&... args) {
+        MessageBuffer buf;
+        auto& out = buf.str();
+        put_header(out, binary::Entry::Record, level, ts);
+        binary::put(out, static_cast<std::uint16_t>(sizeof...(Args)));
+        (binary_encode(out, args), ...);
+        commit(level, meta, fmt, out);
+    }
+
+    void write_message(LogLevel level,
+                       const SourceMeta& meta,
+                       Timestamp ts,
+                       std::string_view msg) {
+        MessageBuffer buf;
+        auto& out = buf.str();
+        put_header(out, binary::Entry::Message, level, ts);
+        binary::put_str(out, msg);
+        commit(level, meta, {}, out);
+    }
+
+    void flush() {
+        std::lock_guard lock(_mutex);
+        std::fflush(_file);
+    }
+
+  private:
+    struct SiteKey {
+        const char* fmt;
+        const char* filename;
+        int line;
+        int column;
+
+        bool operator==(const SiteKey&) const = default;
+    };
+
+    struct SiteKeyHash {
+        std::size_t operator()(const SiteKey& k) const noexcept {
+            auto h = std::hash<const void*> {}(k.fmt) * 31 +
+                     std::hash<const void*> {}(k.filename);
+            return h * 31 + static_cast<std::size_t>(k.line) * 131 +
+                   static_cast<std::size_t>(k.column);
+        }
+    };
+
+    // the site id is patched in under the lock, right after the entry tag
+    static void put_header(std::string& out,
+                           binary::Entry entry,
+                           LogLevel level,
+                           Timestamp ts) {
+        binary::put(out, entry);
+        binary::put(out, std::uint32_t { 0 });
+        binary::put(out, static_cast<std::uint8_t>(level));
+        ts = resolve_time(ts);
+        binary::put(out, ts.sec);
+        binary::put(out, ts.nsec);
+    }
+
+    void commit(LogLevel level,
+                const SourceMeta& meta,
+                std::string_view fmt,
+                std::string& entry) {
+        std::lock_guard lock(_mutex);
+        auto id = site_id(meta, fmt);
+        std::memcpy(entry.data() + sizeof(binary::Entry), &id, sizeof(id));
+        std::fwrite(entry.data(), 1, entry.size(), _file);
+        if (level <= LogLevel::Error) std::fflush(_file);
+    }
+
+    std::uint32_t site_id(const SourceMeta& meta, std::string_view fmt) {
+        SiteKey key { fmt.data(), meta.filename, meta.line, meta.column };
+        auto [it, inserted] = _sites.try_emplace(
+                key, static_cast<std::uint32_t>(_sites.size()));
+        if (inserted) {
+            std::string site;
+            binary::put(site, binary::Entry::Site);
+            binary::put(site, it->second);
+            binary::put(site, static_cast<std::int32_t>(meta.line));
+            binary::put_str(site,
+                            { meta.filename,
+                              static_cast<std::size_t>(meta.filename_len) });
+            binary::put_str(site,
+                            { meta.funcname,
+                              static_cast<std::size_t>(meta.funcname_len) });
+            binary::put_str(site, fmt);
+            std::fwrite(site.data(), 1, site.size(), _file);
+        }
+        return it->second;
+    }
+
+    std::mutex _mutex;
+    std::FILE* _file;
+    std::unordered_map<SiteKey, std::uint32_t, SiteKeyHash> _sites;
+};
+
+inline bool default_logger_enabled(LogLevel level) noexcept {
+    auto threshold = default_logger_level().load(std::memory_order_relaxed);
+    return level_enabled(level, threshold);
+}
+
+// "<name> took 1.234ms", in the largest unit that keeps it above one
+inline void format_elapsed(std::string& out,
+                           std::string_view name,
+                           std::chrono::nanoseconds elapsed) {
+    auto ns = static_cast<double>(elapsed.count());
+    auto it = std::back_inserter(out);
+    if (elapsed < std::chrono::microseconds(1)) {
+        std::format_to(it, "{} took {}ns", name, elapsed.count());
+    } else if (elapsed < std::chrono::milliseconds(1)) {
+        std::format_to(it, "{} took {:.3f}us", name, ns / 1e3);
+    } else if (elapsed < std::chrono::seconds(1)) {
+        std::format_to(it, "{} took {:.3f}ms", name, ns / 1e6);
+    } else {
+        std::format_to(it, "{} took {:.3f}s", name, ns / 1e9);
+    }
+}
+
+// registered for tmb::stats on first use, never destroyed
+inline StatsCounters& default_logger_stats() {
+    static const std::string name;
+    static StatsCounters* counters = [] {
+        auto* c = new StatsCounters;
+        StatsRegistry::add(name, *c);
+        return c;
+    }();
+    return *counters;
+}
+
+_tmb_ccp_CORE__ void log_default_logger_impl(LogLevel level,
+                                             const SourceMeta& meta,
+                                             std::string_view msg);
+_tmb_ccp_CORE__ void log_default_elapsed(LogLevel level,
+                                         const SourceMeta& meta,
+                                         std::string_view name,
+                                         std::chrono::nanoseconds elapsed);
+
+// an enabled default logger call without fields, from here on the
+// arguments are type-erased
+_tmb_ccp_CORE__ void vlog_default_logger(LogLevel level,
+                                         const SourceMeta& meta,
+                                         std::string_view fmt,
+                                         std::format_args args);
+
 template <typename... Args>
 inline void log_default_logger(LogLevel level,
-                               const std::source_location& loc,
+                               const SourceMeta& meta,
                                std::string_view fmt,
                                Args&&... args) {
-    std::string msg;
-    try {
-        msg = std::vformat(fmt, std::make_format_args(args...));
-    } catch (const std::format_error& e) {
-        msg   = std::string("[format error] ") + e.what();
-        level = LogLevel::Error;
+    if (!level_active(level)) return;
+    auto& stats = default_logger_stats();
+    if (!default_logger_enabled(level)) {
+        if constexpr (TMB_COUNT_FILTERED) {
+            stats.filtered(static_cast<int>(level));
+        }
+        return;
+    }
+    if constexpr (message_arg_count<Args...> == sizeof...(Args)) {
+        vlog_default_logger(level, meta, fmt, std::make_format_args(args...));
+    } else {
+        stats.emitted(static_cast<int>(level));
+        MessageBuffer buf;
+        auto msg =
+                format_message(buf, level, FieldStyle::Logfmt, fmt, args...);
+        stats.formatted(msg.size(), buf.failed());
+        log_default_logger_impl(level, meta, msg);
     }
-    log_default_logger_impl(level, loc, msg);
 }
 
-struct format_with_location {
+inline SiteLimit& site_limit(const SourceMeta& meta,
+                            StatsCounters& stats) noexcept {
+    auto& site = SiteLimits::find(
+            meta.filename, meta.funcname, meta.line, meta.column);
+    if (site.overflow) stats.site_overflow();
+    return site;
+}
+
+inline SiteLimit& default_site_limit(const SourceMeta& meta) noexcept {
+    return site_limit(meta, default_logger_stats());
+}
+
+struct runtime_format_string {
+    std::string_view value;
+};
+
+template <typename... Args>
+struct basic_format_with_location {
+    static_assert(fields_trailing<Args...>,
+                  "tmb::kv fields go after all format arguments");
+
     std::string_view value;
-    std::source_location loc;
+    SourceMeta meta;
+    bool checked; // only checked strings are known to outlive the call
 
+    // checked against the format arguments (Args minus the fields) at
+    // compile time
     template <typename String>
-    format_with_location(const String& s,
-                         const std::source_location& location =
-                                 std::source_location::current()) :
-        value { s }, loc { location } {}
+        requires std::convertible_to<const String&, std::string_view>
+    consteval basic_format_with_location(
+            const String& s,
+            const std::source_location& location =
+                    std::source_location::current()) :
+        value { message_format_string<Args...>(s).get() },
+        meta { location },
+        checked { true } {}
+
+    // opt-in via tmb::runtime(), errors are reported as [format error]
+    basic_format_with_location(runtime_format_string s,
+                               const std::source_location& location =
+                                       std::source_location::current()) :
+        value { s.value }, meta { location }, checked { false } {}
 };
 
+template <typename... Args>
+using format_with_location =
+        basic_format_with_location<std::type_identity_t<Args>...>;
+
 } // namespace internal
 
+// Wraps a format string that is only known at runtime, skipping the
+// compile-time check
+inline internal::runtime_format_string runtime(std::string_view fmt) noexcept {
+    return { fmt };
+}
+
+// An argument computed only when the record is actually formatted, i.e.
+// after the level check passed:
+//
+//   lgr.debug("book {}", tmb::lazy([&] { return to_string(book); }));
+//
+// The result is formatted with the format spec of the placeholder. Lazy
+// arguments are always formatted on the calling thread, so the callable
+// may capture by reference.
+template <typename F>
+    requires std::invocable<const F&>
+struct Lazy {
+    F fn;
+};
+
+template <typename F>
+Lazy<std::decay_t<F>> lazy(F&& fn) {
+    return { std::forward<F>(fn) };
+}
+
 class Logger {
   public:
     Logger(std::string_view name,
            const c::tmb_logger_cfg_t& cfg = {
                    .log_level     = c::TMB_LOG_LEVEL_DEBUG,
                    .enable_colors = true,
-           }) {
-        _logger = c::tmb_logger_create(name.data(), cfg);
-        if (!_logger) { throw std::runtime_error("Failed to create logger"); }
-        _name = std::string(name);
-    }
+           });
 
-    ~Logger() {
-        if (_logger) {
-            c::tmb_logger_destroy(_logger);
-            _logger = nullptr;
-        }
-    }
+    // Records are formatted on the calling thread and written by a background
+    // thread, see AsyncOptions for the queue size and overflow behaviour
+    Logger(std::string_view name,
+           const c::tmb_logger_cfg_t& cfg,
+           const AsyncOptions& async);
+
+    ~Logger();
 
     Logger(const Logger&)            = delete;
     Logger& operator=(const Logger&) = delete;
     Logger(Logger&& other) noexcept :
-        _logger(other._logger), _name(std::move(other._name)) {
+        _logger(other._logger),
+        _name(std::move(other._name)),
+        _level(other._level.load(std::memory_order_relaxed)),
+        _clock(other._clock.load(std::memory_order_relaxed)),
+        _fields(other._fields.load(std::memory_order_relaxed)),
+        _out(std::move(other._out)),
+        _async(std::move(other._async)),
+        _binary(std::move(other._binary)) {
         other._logger = nullptr;
     }
 
     Logger& operator=(Logger&& other) noexcept {
         if (this != &other) {
+            _async.reset();
             if (_logger) c::tmb_logger_destroy(_logger);
             _logger       = other._logger;
             _name         = std::move(other._name);
             other._logger = nullptr;
+            _level.store(other._level.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+            _clock.store(other._clock.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+            _fields.store(other._fields.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+            _out    = std::move(other._out);
+            _async  = std::move(other._async);
+            _binary = std::move(other._binary);
         }
         return *this;
     }
 
+    const std::string& name() const noexcept { return _name; }
+
+    LogLevel level() const noexcept {
+        return static_cast<LogLevel>(_level.load(std::memory_order_relaxed));
+    }
+
+    // takes effect for calls that start after it, from any thread
+    void set_level(LogLevel level) noexcept {
+        _level.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    bool should_log(LogLevel level) const noexcept {
+        return internal::level_enabled(
+                level, _level.load(std::memory_order_relaxed));
+    }
+
     template <typename... Args>
     void log(LogLevel level,
              const std::source_location& loc,
              std::string_view fmt,
              Args&&... args) {
-        std::string msg;
-        try {
-            msg = std::vformat(fmt, std::make_format_args(args...));
-        } catch (const std::format_error& e) {
-            msg   = std::string("[format error] ") + e.what();
-            level = LogLevel::Error;
-        }
-        log_impl(level, loc, msg);
+        log(level, internal::SourceMeta(loc), fmt, std::forward<Args>(args)...);
     }
 
+    template <typename... Args>
+    void log(LogLevel level,
+             internal::format_with_location<Args...> fmt,
+             Args&&... args) {
+        if (!internal::level_active(level) || !enabled(level)) return;
+        log_enabled(level, fmt, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void log(LogLevel level,
+             const internal::SourceMeta& meta,
+             std::string_view fmt,
+             Args&&... args) {
+        if (!internal::level_active(level) || !enabled(level)) return;
+        _out->stats().emitted(static_cast<int>(level));
+        format_and_write(level, meta, fmt, args...);
+    }
+
+    // The _every_n, _every and _sampled variants keep state per call site
+    // and skip formatting entirely for suppressed calls:
+    //   info_every_n(100, ...)   1st, 101st, 201st... call
+    //   info_every(1s, ...)      at most one call per second
+    //   info_sampled(0.01, ...)  about 1% of the calls
 #define _tmb_ccp_LOG_LEVEL__(_m_name, _m_level)                                \
     template <typename... Args>                                                \
-    void _m_name(internal::format_with_location fmt, Args&&... args) {         \
-        log(_m_level, fmt.loc, fmt.value, std::forward<Args>(args)...);        \
+    void _m_name(internal::format_with_location<Args...> fmt,                 \
+                 Args&&... args) {                                             \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            log(_m_level, fmt, std::forward<Args>(args)...);                   \
+        }                                                                      \
+    }                                                                          \
+    template <typename... Args>                                                \
+    void _m_name##_every_n(std::uint64_t n,                                    \
+                           internal::format_with_location<Args...> fmt,       \
+                           Args&&... args) {                                   \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            if (enabled(_m_level) &&                                           \
+                internal::every_n(site_limit(fmt.meta), n))                    \
+                log_enabled(_m_level, fmt, std::forward<Args>(args)...);       \
+        }                                                                      \
+    }                                                                          \
+    template <typename... Args>                                                \
+    void _m_name##_every(std::chrono::nanoseconds period,                      \
+                         internal::format_with_location<Args...> fmt,         \
+                         Args&&... args) {                                     \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            if (enabled(_m_level) &&                                           \
+                internal::every(site_limit(fmt.meta), period))                 \
+                log_enabled(_m_level, fmt, std::forward<Args>(args)...);       \
+        }                                                                      \
+    }                                                                          \
+    template <typename... Args>                                                \
+    void _m_name##_sampled(double p,                                           \
+                           internal::format_with_location<Args...> fmt,       \
+                           Args&&... args) {                                   \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            if (enabled(_m_level) && internal::sampled(p))                     \
+                log_enabled(_m_level, fmt, std::forward<Args>(args)...);       \
+        }                                                                      \
     }
 
     _tmb_ccp_LOG_LEVEL__(fatal, LogLevel::Fatal);
@@ -185,26 +1905,339 @@ class Logger {
         return c::tmb_logger_set_default_format(this->_logger, fmt);
     }
 
+    // Switches this logger to the compact binary format, records are
+    // appended to path instead of going to timber-c. Decode the file with
+    // tmb-decode. Call it before other threads start logging.
+    bool set_binary_output(const char* path) {
+        auto* file = std::fopen(path, "wb");
+        if (!file) return false;
+        _binary = std::make_unique<internal::BinaryWriter>(file, _name);
+        return true;
+    }
+
+    // How sinks render this logger's records, see Layout. Safe to call while
+    // other threads log.
+    void set_layout(Layout layout) { _out->set_layout(std::move(layout)); }
+
+    // false if the pattern doesn't parse, the layout is left as it was then
+    bool set_layout(std::string_view pattern) {
+        try {
+            set_layout(Layout(pattern));
+        } catch (const std::invalid_argument&) {
+            return false;
+        }
+        return true;
+    }
+
+    // the pattern is checked and compiled at compile time
+    template <internal::fixed_string Pattern>
+    void set_layout() {
+        set_layout(Layout::compiled<Pattern>());
+    }
+
+    // Records go to the added sinks instead of timber-c. Add sinks before
+    // other threads start logging.
+    void add_sink(std::shared_ptr<Sink> sink) {
+        _out->add_sink(std::move(sink));
+    }
+
+    // Safe to call while other threads log, records already stamped keep
+    // their time
+    void set_clock(ClockPolicy policy) {
+        // pay for the ticker thread start or the calibration here, not in
+        // the first record
+        if (policy == ClockPolicy::Cached) internal::cached_clock_now();
+        if (policy == ClockPolicy::Tsc) internal::CycleCalibration::get();
+        _clock.store(policy, std::memory_order_relaxed);
+    }
+
+    ClockPolicy clock() const noexcept {
+        return _clock.load(std::memory_order_relaxed);
+    }
+
+    // how tmb::kv fields are rendered, logfmt by default
+    void set_field_style(FieldStyle style) noexcept {
+        _fields.store(style, std::memory_order_relaxed);
+    }
+
+    FieldStyle field_style() const noexcept {
+        return _fields.load(std::memory_order_relaxed);
+    }
+
+    bool is_async() const noexcept { return _async != nullptr; }
+
+    c::tmb_logger_t* handle() const noexcept { return _logger; }
+
+    // blocks until every queued record has been written and the sinks have
+    // flushed their buffers
+    void flush() noexcept;
+
+    // records discarded by the async overflow policy
+    std::uint64_t dropped() const noexcept {
+        return _async ? _async->dropped() : 0;
+    }
+
+    // Logs "<name> took <elapsed>" with the stopwatch fields set to elapsed,
+    // what Span does when it ends. The level check is left to the caller.
+    void log_elapsed(LogLevel level,
+                     const internal::SourceMeta& meta,
+                     std::string_view name,
+                     std::chrono::nanoseconds elapsed);
+
+    class Batch;
+
+    // Collects records and hands them over together when it goes out of
+    // scope, see Batch
+    Batch batch();
+
+    // this logger's counters, see LoggerStats
+    LoggerStats stats() const {
+        LoggerStats out;
+        out.name = _name;
+        _out->stats().read(out);
+        return out;
+    }
+
   private:
+    // should_log, counting the calls it stops if TMB_COUNT_FILTERED is set
+    bool enabled(LogLevel level) noexcept {
+        if (should_log(level)) return true;
+        if constexpr (TMB_COUNT_FILTERED) {
+            _out->stats().filtered(static_cast<int>(level));
+        }
+        return false;
+    }
+
+    // callers have done the level check, so enabled calls read the level
+    // exactly once
+    template <typename... Args>
+    void log_enabled(LogLevel level,
+                     internal::format_with_location<Args...> fmt,
+                     Args&&... args) {
+        _out->stats().emitted(static_cast<int>(level));
+        if constexpr ((internal::binary_arg<std::remove_cvref_t<Args>> &&
+                       ...)) {
+            if (_binary && fmt.checked && !internal::has_context()) {
+                _binary->write(
+                        level, fmt.meta, fmt.value, stamp(true), args...);
+                return;
+            }
+        }
+        if constexpr ((internal::deferred_arg<Args> && ...)) {
+            // fatal records take the flushing path in log_impl
+            if (_async && _async->deferred() && fmt.checked &&
+                level != LogLevel::Fatal && !internal::has_context() &&
+                _async->push_deferred(
+                        level, fmt.meta, stamp(true), fmt.value, args...)) {
+                return;
+            }
+        }
+        format_and_write(level, fmt.meta, fmt.value, args...);
+    }
+
+    template <typename... Args>
+    void format_and_write(LogLevel level,
+                          const internal::SourceMeta& meta,
+                          std::string_view fmt,
+                          Args&... args) {
+        if constexpr (internal::message_arg_count<Args...> ==
+                      sizeof...(Args)) {
+            vformat_and_write(level, meta, fmt, std::make_format_args(args...));
+        } else {
+            internal::MessageBuffer buf;
+            auto msg = internal::format_message(
+                    buf, level, field_style(), fmt, args...);
+            _out->stats().formatted(msg.size(), buf.failed());
+            log_impl(level, meta, msg);
+        }
+    }
+
+    // format_and_write for calls without fields, the part all call sites
+    // share
+    void vformat_and_write(LogLevel level,
+                           const internal::SourceMeta& meta,
+                           std::string_view fmt,
+                           std::format_args args);
+
     void log_impl(LogLevel level,
-                  const std::source_location& loc,
-                  std::string_view msg) {
-        c::tmb_log(internal::LogContext(level, loc).to_c(),
-                   _logger,
-                   "%.*s",
-                   static_cast<int>(msg.size()),
-                   msg.data());
+                  const internal::SourceMeta& meta,
+                  std::string_view msg,
+                  internal::Timestamp stopwatch = {});
+
+    // Timestamps are taken on the logging thread. With the default policy
+    // and timber-c as the destination the record goes out unstamped and
+    // timber-c takes the time itself.
+    internal::SiteLimit& site_limit(
+            const internal::SourceMeta& meta) noexcept {
+        return internal::site_limit(meta, _out->stats());
+    }
+
+    internal::Timestamp stamp(bool required) const noexcept {
+        auto policy = _clock.load(std::memory_order_relaxed);
+        if (policy == ClockPolicy::Default && !required) return {};
+        return internal::clock_now(policy);
     }
+
     c::tmb_logger_t* _logger { nullptr };
     std::string _name;
+    std::atomic<int> _level;
+    std::atomic<ClockPolicy> _clock { ClockPolicy::Default };
+    std::atomic<FieldStyle> _fields { FieldStyle::Logfmt };
+    std::unique_ptr<internal::Dispatcher> _out;
+    std::unique_ptr<internal::AsyncWorker> _async;
+    std::unique_ptr<internal::BinaryWriter> _binary;
 };
 
+// Records logged through a batch are formatted and timestamped right away,
+// and written in one go when it's submitted or destroyed:
+//
+//   auto batch = lgr.batch();
+//   for (const auto& row : rows) {
+//       if (!row.valid()) batch.warn("rejected row {}: {}", row.id, row.why);
+//   }
+//
+// Sinks get the whole batch in one write_batch call, an async logger wakes
+// its writer once. The logger's level is read when the batch is made, a
+// disabled record then costs a compare. A batch belongs to one thread and
+// must not outlive (or follow a move of) its logger.
+class Logger::Batch {
+  public:
+    explicit Batch(Logger& logger) :
+        _logger(&logger),
+        _level(logger._level.load(std::memory_order_relaxed)),
+        _fields(logger.field_style()),
+        _buf(&internal::thread_batch_buffers()) {
+        // a batch made while another one is open gets buffers of its own
+        if (_buf->in_use) _buf = &_own;
+        _buf->in_use = true;
+    }
+
+    ~Batch() {
+        submit();
+        _buf->in_use = false;
+        // don't let one huge batch pin its memory for the thread's lifetime
+        if (_buf->text.capacity() > 1024 * TMB_MESSAGE_BUFFER_SIZE) {
+            _buf->text    = std::string();
+            _buf->records = std::vector<internal::BatchRecord>();
+        }
+    }
+
+    Batch(const Batch&)            = delete;
+    Batch& operator=(const Batch&) = delete;
+
+    bool should_log(LogLevel level) const noexcept {
+        return internal::level_enabled(level, _level);
+    }
+
+    template <typename... Args>
+    void log(LogLevel level,
+             internal::format_with_location<Args...> fmt,
+             Args&&... args) {
+        if (!internal::level_active(level) || !should_log(level)) return;
+        add(level, fmt.meta, fmt.value, args...);
+    }
+
+#define _tmb_ccp_BATCH_LEVEL__(_m_name, _m_level)                              \
+    template <typename... Args>                                                \
+    void _m_name(internal::format_with_location<Args...> fmt,                 \
+                 Args&&... args) {                                             \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            log(_m_level, fmt, std::forward<Args>(args)...);                   \
+        }                                                                      \
+    }
+
+    _tmb_ccp_BATCH_LEVEL__(fatal, LogLevel::Fatal);
+    _tmb_ccp_BATCH_LEVEL__(error, LogLevel::Error);
+    _tmb_ccp_BATCH_LEVEL__(warning, LogLevel::Warning);
+    _tmb_ccp_BATCH_LEVEL__(warn, LogLevel::Warning);
+    _tmb_ccp_BATCH_LEVEL__(info, LogLevel::Info);
+    _tmb_ccp_BATCH_LEVEL__(debug, LogLevel::Debug);
+    _tmb_ccp_BATCH_LEVEL__(trace, LogLevel::Trace);
+#undef _tmb_ccp_BATCH_LEVEL__
+
+    // records collected since the last submit
+    std::size_t size() const noexcept { return _buf->records.size(); }
+
+    // writes what's been collected, the batch can be reused afterwards
+    void submit() noexcept;
+
+  private:
+    template <typename... Args>
+    void add(LogLevel level,
+             const internal::SourceMeta& meta,
+             std::string_view fmt,
+             Args&... args) {
+        auto& stats = _logger->_out->stats();
+        stats.emitted(static_cast<int>(level));
+        internal::MessageBuffer buf;
+        auto msg = internal::format_message(buf, level, _fields, fmt, args...);
+        stats.formatted(msg.size(), buf.failed());
+        auto ts    = _logger->stamp(true);
+        auto& text = _buf->text;
+        _buf->records.push_back({ level, meta, ts, text.size(), msg.size() });
+        text.append(msg);
+    }
+
+    Logger* _logger;
+    int _level;
+    FieldStyle _fields;
+    internal::BatchBuffers* _buf;
+    internal::BatchBuffers _own;
+};
+
+inline Logger::Batch Logger::batch() { return Batch(*this); }
+
 // https://github.com/gabime/spdlog/issues/1959
 #define _tmb_ccp_LOG_LEVEL__(_m_name, _m_level)                                \
     template <typename... Args>                                                \
-    void _m_name(internal::format_with_location fmt, Args&&... args) {         \
-        internal::log_default_logger(                                          \
-                _m_level, fmt.loc, fmt.value, std::forward<Args>(args)...);    \
+    void _m_name(internal::format_with_location<Args...> fmt,                 \
+                 Args&&... args) {                                             \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            internal::log_default_logger(_m_level,                             \
+                                         fmt.meta,                             \
+                                         fmt.value,                            \
+                                         std::forward<Args>(args)...);         \
+        }                                                                      \
+    }                                                                          \
+    template <typename... Args>                                                \
+    void _m_name##_every_n(std::uint64_t n,                                    \
+                           internal::format_with_location<Args...> fmt,       \
+                           Args&&... args) {                                   \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            if (internal::default_logger_enabled(_m_level) &&                  \
+                internal::every_n(internal::default_site_limit(fmt.meta), n))  \
+                internal::log_default_logger(_m_level,                         \
+                                             fmt.meta,                         \
+                                             fmt.value,                        \
+                                             std::forward<Args>(args)...);     \
+        }                                                                      \
+    }                                                                          \
+    template <typename... Args>                                                \
+    void _m_name##_every(std::chrono::nanoseconds period,                      \
+                         internal::format_with_location<Args...> fmt,         \
+                         Args&&... args) {                                     \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            if (internal::default_logger_enabled(_m_level) &&                  \
+                internal::every(internal::default_site_limit(fmt.meta),        \
+                                period))                                       \
+                internal::log_default_logger(_m_level,                         \
+                                             fmt.meta,                         \
+                                             fmt.value,                        \
+                                             std::forward<Args>(args)...);     \
+        }                                                                      \
+    }                                                                          \
+    template <typename... Args>                                                \
+    void _m_name##_sampled(double p,                                           \
+                           internal::format_with_location<Args...> fmt,       \
+                           Args&&... args) {                                   \
+        if constexpr (internal::level_active(_m_level)) {                      \
+            if (internal::default_logger_enabled(_m_level) &&                  \
+                internal::sampled(p))                                          \
+                internal::log_default_logger(_m_level,                         \
+                                             fmt.meta,                         \
+                                             fmt.value,                        \
+                                             std::forward<Args>(args)...);     \
+        }                                                                      \
     }
 
 _tmb_ccp_LOG_LEVEL__(fatal, LogLevel::Fatal);
@@ -215,11 +2248,45 @@ _tmb_ccp_LOG_LEVEL__(info, LogLevel::Info);
 _tmb_ccp_LOG_LEVEL__(debug, LogLevel::Debug);
 _tmb_ccp_LOG_LEVEL__(trace, LogLevel::Trace);
 
+inline void set_level(LogLevel level) noexcept {
+    internal::default_logger_level().store(static_cast<int>(level),
+                                           std::memory_order_relaxed);
+}
+
+inline LogLevel get_level() noexcept {
+    return static_cast<LogLevel>(
+            internal::default_logger_level().load(std::memory_order_relaxed));
+}
+
 inline bool set_default_format(const char* fmt) {
-    return c::tmb_logger_set_default_format(c::tmb_get_default_logger(), fmt);
+    return c::tmb_logger_set_default_format(internal::default_c_logger(),
+                                            fmt);
+}
+
+// The counters of every live Logger, and of the default logger under the
+// name "". Meant to be polled by a metrics exporter: it takes a lock that
+// logging threads never take.
+inline std::vector<LoggerStats> stats() {
+    internal::default_logger_stats();
+    return internal::StatsRegistry::read();
 }
 
 #undef _tmb_ccp_LOG_LEVEL__
 } // namespace tmb
 
+template <typename F, typename CharT>
+struct std::formatter<tmb::Lazy<F>, CharT> :
+    std::formatter<std::remove_cvref_t<std::invoke_result_t<const F&>>,
+                   CharT> {
+    template <typename Context>
+    auto format(const tmb::Lazy<F>& arg, Context& ctx) const {
+        using Result = std::remove_cvref_t<std::invoke_result_t<const F&>>;
+        return std::formatter<Result, CharT>::format(std::invoke(arg.fn), ctx);
+    }
+};
+
+#if _tmb_ccp_CORE_DEFS__
+    #include <tmb/internal/core_impl.hpp>
+#endif
+
 #endif // TMB_CPP_HPP_
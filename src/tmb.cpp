@@ -0,0 +1,9 @@
+// The timber-cpp-compiled library: the logging core of tmb.hpp, compiled
+// once. Code linking it is built with TMB_COMPILED_LIB, the CMake target
+// passes that on.
+#ifndef TMB_COMPILED_LIB
+    #define TMB_COMPILED_LIB
+#endif
+#define TMB_CORE_SOURCE
+
+#include <tmb/tmb.hpp>
@@ -0,0 +1,276 @@
+// Turns files written by Logger::set_binary_output back into text, rendered
+// through timber-c with the original timestamps and locations.
+//
+//   tmb-decode [--format <timber format>] <file>...
+
+#include <tmb/internal/binary_format.hpp>
+#include <tmb/tmb.hpp>
+
+#include <charconv>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace {
+
+namespace binary = tmb::internal::binary;
+
+using Value = std::variant<bool,
+                           char,
+                           std::int64_t,
+                           std::uint64_t,
+                           double,
+                           std::string_view,
+                           const void*>;
+
+struct Site {
+    tmb::internal::SourceMeta meta;
+    std::string_view fmt;
+};
+
+Value read_value(binary::Cursor& in) {
+    switch (in.get<binary::Arg>()) {
+    case binary::Arg::Bool: return in.get<std::uint64_t>() != 0;
+    case binary::Arg::Char: return static_cast<char>(in.get<std::uint64_t>());
+    case binary::Arg::Int: return in.get<std::int64_t>();
+    case binary::Arg::UInt: return in.get<std::uint64_t>();
+    case binary::Arg::Double: return in.get<double>();
+    case binary::Arg::String: return in.get_str();
+    case binary::Arg::Pointer:
+        return reinterpret_cast<const void*>(
+                static_cast<std::uintptr_t>(in.get<std::uint64_t>()));
+    default: throw std::format_error("unknown argument type");
+    }
+}
+
+std::size_t to_index(const Value& v) {
+    return std::visit(
+            [](const auto& x) -> std::size_t {
+                using T = std::decay_t<decltype(x)>;
+                if constexpr (std::is_same_v<T, std::int64_t> ||
+                              std::is_same_v<T, std::uint64_t>) {
+                    return static_cast<std::size_t>(x);
+                } else {
+                    throw std::format_error("dynamic spec is not an integer");
+                }
+            },
+            v);
+}
+
+const Value& arg_at(const std::vector<Value>& args, std::size_t i) {
+    if (i >= args.size()) throw std::format_error("argument not found");
+    return args[i];
+}
+
+std::size_t parse_id(std::string_view id, std::size_t& next) {
+    if (id.empty()) return next++;
+    std::size_t i = 0;
+    auto res      = std::from_chars(id.data(), id.data() + id.size(), i);
+    if (res.ec != std::errc {}) throw std::format_error("bad argument id");
+    return i;
+}
+
+// Replaces nested {} in a format spec (dynamic width/precision) by the
+// integer they refer to
+std::string resolve_spec(std::string_view spec,
+                         const std::vector<Value>& args,
+                         std::size_t& next) {
+    std::string out;
+    for (std::size_t i = 0; i < spec.size(); ++i) {
+        if (spec[i] != '{') {
+            out += spec[i];
+            continue;
+        }
+        auto close = spec.find('}', i);
+        if (close == std::string_view::npos) {
+            throw std::format_error("unmatched '{' in spec");
+        }
+        auto id = parse_id(spec.substr(i + 1, close - i - 1), next);
+        out += std::to_string(to_index(arg_at(args, id)));
+        i = close;
+    }
+    return out;
+}
+
+// std::format needs the argument types at compile time, so the decoder
+// walks the format string and formats one replacement field at a time
+std::string render(std::string_view fmt, const std::vector<Value>& args) {
+    std::string out;
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < fmt.size(); ++i) {
+        char ch = fmt[i];
+        if ((ch == '{' || ch == '}') && i + 1 < fmt.size() &&
+            fmt[i + 1] == ch) {
+            out += ch;
+            ++i;
+            continue;
+        }
+        if (ch != '{') {
+            out += ch;
+            continue;
+        }
+        std::size_t close = i + 1;
+        for (int depth = 1; close < fmt.size(); ++close) {
+            if (fmt[close] == '{') ++depth;
+            if (fmt[close] == '}' && --depth == 0) break;
+        }
+        if (close >= fmt.size()) throw std::format_error("unmatched '{'");
+
+        auto field = fmt.substr(i + 1, close - i - 1);
+        auto colon = field.find(':');
+        auto id    = parse_id(field.substr(0, colon), next);
+        std::string spec = "{:";
+        if (colon != std::string_view::npos) {
+            spec += resolve_spec(field.substr(colon + 1), args, next);
+        }
+        spec += '}';
+        std::visit(
+                [&](const auto& v) {
+                    std::vformat_to(std::back_inserter(out),
+                                    spec,
+                                    std::make_format_args(v));
+                },
+                arg_at(args, id));
+        i = close;
+    }
+    return out;
+}
+
+tmb::internal::SourceMeta make_meta(std::string_view file,
+                                    std::string_view func,
+                                    int line) {
+    tmb::internal::SourceMeta meta;
+    meta.filename      = file.data();
+    meta.filename_len  = static_cast<int>(file.size());
+    meta.funcname      = func.data();
+    meta.funcname_len  = static_cast<int>(func.size());
+    meta.line          = line;
+    auto slash         = file.find_last_of("/\\");
+    auto base          = slash == std::string_view::npos ? 0 : slash + 1;
+    meta.filename_base = file.data() + base;
+    meta.filename_base_len = static_cast<int>(file.size() - base);
+    return meta;
+}
+
+bool decode(const std::string& data, const char* format) {
+    binary::Cursor in(data);
+    char magic[sizeof(binary::magic)];
+    for (auto& c : magic) c = in.get<char>();
+    if (std::string_view(magic, sizeof(magic)) !=
+                std::string_view(binary::magic, sizeof(binary::magic)) ||
+        in.get<std::uint32_t>() != binary::version) {
+        std::fprintf(stderr, "tmb-decode: not a timber-cpp binary log\n");
+        return false;
+    }
+
+    tmb::Logger logger(std::string(in.get_str()),
+                       { .log_level     = tmb::c::TMB_LOG_LEVEL_ALL,
+                         .enable_colors = true });
+    if (format) logger.set_default_format(format);
+
+    // file/function names must be NUL terminated for timber-c, a deque keeps
+    // them in place as more are added
+    std::vector<Site> sites;
+    std::deque<std::string> names;
+
+    std::vector<Value> args;
+    while (!in.at_end() && !in.failed()) {
+        auto entry = in.get<binary::Entry>();
+        if (entry == binary::Entry::Site) {
+            auto id   = in.get<std::uint32_t>();
+            auto line = in.get<std::int32_t>();
+            auto& file = names.emplace_back(in.get_str());
+            auto& func = names.emplace_back(in.get_str());
+            if (in.failed()) break;
+            // the writer numbers sites in order, a later id is corruption and
+            // mustn't size the table
+            if (id > sites.size()) {
+                std::fprintf(stderr, "tmb-decode: corrupt site entry\n");
+                return false;
+            }
+            if (id == sites.size()) sites.emplace_back();
+            sites[id] = { make_meta(file, func, line), in.get_str() };
+            continue;
+        }
+
+        auto id    = in.get<std::uint32_t>();
+        auto level = static_cast<tmb::LogLevel>(in.get<std::uint8_t>());
+        tmb::internal::Timestamp ts { in.get<std::int64_t>(),
+                                      in.get<std::int64_t>() };
+        if (id >= sites.size()) {
+            std::fprintf(stderr, "tmb-decode: record for unknown site\n");
+            return false;
+        }
+        const auto& site = sites[id];
+
+        std::string msg;
+        if (entry == binary::Entry::Message) {
+            msg = in.get_str();
+        } else if (entry == binary::Entry::Record) {
+            args.clear();
+            auto argc = in.get<std::uint16_t>();
+            try {
+                for (std::uint16_t i = 0; i < argc; ++i) {
+                    args.push_back(read_value(in));
+                }
+                msg = render(site.fmt, args);
+            } catch (const std::format_error& e) {
+                msg   = std::string("[format error] ") + e.what();
+                level = tmb::LogLevel::Error;
+            }
+        } else {
+            std::fprintf(stderr, "tmb-decode: corrupt entry\n");
+            return false;
+        }
+        if (in.failed()) break;
+        tmb::internal::emit(
+                logger.handle(),
+                tmb::internal::LogContext(level, site.meta, ts).to_c(),
+                msg);
+    }
+    if (in.failed()) {
+        std::fprintf(stderr, "tmb-decode: truncated file\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* format = nullptr;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        std::fprintf(stderr,
+                     "usage: tmb-decode [--format <timber format>] "
+                     "<file>...\n");
+        return 2;
+    }
+
+    int status = 0;
+    for (auto* path : files) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::fprintf(stderr, "tmb-decode: cannot open %s\n", path);
+            status = 1;
+            continue;
+        }
+        std::string data((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+        if (!decode(data, format)) status = 1;
+    }
+    return status;
+}